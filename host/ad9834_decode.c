@@ -0,0 +1,49 @@
+/*
+* Decode a stream of words sent to the AD9834 and report each change of the output.
+*
+* Reads one word per line from stdin, either as "<hex word>" or as "<time_ns> <hex word>", where the time is
+* when the last bit of the word was clocked in. Lines without a time are spaced word_spacing_ns apart, which
+* defaults to the time dds_send_16_bits() takes at 16.384 MHz. Lines starting with # are ignored.
+*
+* Build: gcc -std=c99 -O2 -o ad9834_decode ad9834_decode.c ad9834_model.c
+* Usage: ad9834_decode [word_spacing_ns] < words.txt
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ad9834_model.h"
+
+#define DEFAULT_WORD_SPACING_NS 13000ULL		// About 210 MCU cycles per word at 16.384 MHz
+
+static ad9834_model_t model;
+
+int main(int argc, char** argv)
+{
+	uint64_t word_spacing_ns = argc > 1 ? strtoull(argv[1], NULL, 0) : DEFAULT_WORD_SPACING_NS;
+	uint64_t time_ns = 0;
+	char line[128];
+	
+	ad9834_init(&model);
+	while (fgets(line, sizeof(line), stdin)) {
+		char first[32];
+		char second[32];
+		unsigned long word;
+		if (line[0] == '#') {
+			continue;
+		}
+		int num_fields = sscanf(line, "%31s %31s", first, second);
+		if (num_fields == 2) {
+			time_ns = strtoull(first, NULL, 10);
+			word = strtoul(second, NULL, 16);
+		} else if (num_fields == 1) {
+			time_ns += word_spacing_ns;
+			word = strtoul(first, NULL, 16);
+		} else {
+			continue;											// Blank line
+		}
+		ad9834_write(&model, time_ns, (uint16_t)word);
+	}
+	
+	ad9834_print_changes(&model, stdout);
+	return 0;
+}
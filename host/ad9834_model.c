@@ -0,0 +1,192 @@
+/*
+* Behavioral model of the Analog Devices AD9834 DDS chip, for testing the DDS code on the host.
+*
+* Only the digital behavior that matters to the siggen firmware is modeled: register decoding, the B28
+* and HLB frequency write sequences, FSEL/PSEL/RESET under software control, and the phase accumulator.
+* Register updates reach the output AD9834_LATENCY_MCLK master clock cycles after the last bit of the
+* word is clocked in. With PIN/SW set, the FSELECT, PSELECT and RESET pins are assumed to be held low.
+*/
+
+#include <string.h>
+#include "ad9834_model.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Private functions
+//////////////////////////////////////////////////////////////////////////
+
+static uint64_t ad9834_ns_to_mclk(uint64_t time_ns)
+{
+	return time_ns * AD9834_MCLK_HZ / 1000000000ULL;
+}
+
+// Advance the phase accumulator to the given time using the current output state
+static void ad9834_advance_mclk(ad9834_model_t* model, uint64_t mclk)
+{
+	if (mclk <= model->now_mclk) {
+		return;
+	}
+	if (model->out_reset) {
+		model->accumulator = 0;							// Accumulator is held at zero while in reset
+	} else {
+		uint64_t cycles = mclk - model->now_mclk;
+		model->accumulator = (uint32_t)((model->accumulator + cycles * model->out_tuning_word) & 0x0FFFFFFF);
+	}
+	model->now_mclk = mclk;
+}
+
+// Work out which tuning word, phase offset and reset state the registers now select
+static void ad9834_selected(const ad9834_model_t* model, uint32_t* tuning_word, uint16_t* phase, bool* reset)
+{
+	bool fsel = false;
+	bool psel = false;
+	*reset = false;
+	if (!(model->control & AD9834_CTRL_PIN_SW)) {			// Software control; with pin control the pins are low
+		fsel = model->control & AD9834_CTRL_FSEL;
+		psel = model->control & AD9834_CTRL_PSEL;
+	}
+	*reset = model->control & AD9834_CTRL_RESET;			// RESET bit works under both pin and software control
+	*tuning_word = model->freq[fsel ? 1 : 0];
+	*phase = model->phase[psel ? 1 : 0];
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public functions
+//////////////////////////////////////////////////////////////////////////
+
+// Put the model in the power-up state. Register contents are unknown at power-up; the model uses zero. The
+// output is taken to be in reset, since the datasheet requires a reset before the output is used, so the
+// reset word that starts initialization is not reported as a change.
+void ad9834_init(ad9834_model_t* model)
+{
+	memset(model, 0, sizeof(*model));
+	model->b28_pending_reg = -1;
+	model->out_reset = true;
+}
+
+// Decode one 16-bit word whose last bit was clocked in at time_ns. Times must not decrease.
+void ad9834_write(ad9834_model_t* model, uint64_t time_ns, uint16_t word)
+{
+	uint64_t mclk = ad9834_ns_to_mclk(time_ns);
+	uint16_t data = word & 0x3FFF;
+	bool half_write = false;								// Only half of a frequency register was updated
+	
+	model->num_words++;
+	if (!model->command_open) {
+		model->command_open = true;
+		model->command_mclk = mclk;
+	}
+	
+	switch (word >> 14) {
+	case 0:													// DB15,DB14 = 00 : Control register
+		model->control = data;
+		if (!(data & AD9834_CTRL_B28)) {
+			model->b28_pending_reg = -1;
+		}
+		break;
+	case 1:													// DB15,DB14 = 01 : FREQ0 register
+	case 2: {												// DB15,DB14 = 10 : FREQ1 register
+		uint8_t reg = (word >> 14) - 1;
+		if (model->control & AD9834_CTRL_B28) {
+			// Two consecutive writes: 14 LSBs are held, then loaded with the 14 MSBs as one 28-bit word
+			if (model->b28_pending_reg != reg) {
+				model->b28_lsb = data;
+				model->b28_pending_reg = reg;
+			} else {
+				model->freq[reg] = ((uint32_t)data << 14) | model->b28_lsb;
+				model->b28_pending_reg = -1;
+			}
+		} else if (model->control & AD9834_CTRL_HLB) {
+			model->freq[reg] = (model->freq[reg] & 0x00003FFF) | ((uint32_t)data << 14);
+			half_write = true;
+		} else {
+			model->freq[reg] = (model->freq[reg] & 0x0FFFC000) | data;
+			half_write = true;
+		}
+		break;
+	}
+	case 3:													// DB15,DB14 = 11 : PHASE0 or PHASE1 register, selected by DB13
+		model->phase[(word & 0x2000) ? 1 : 0] = word & 0x0FFF;
+		break;
+	}
+	
+	uint32_t tuning_word;
+	uint16_t phase;
+	bool reset;
+	ad9834_selected(model, &tuning_word, &phase, &reset);
+	if (reset == model->out_reset && (reset || (tuning_word == model->out_tuning_word && phase == model->out_phase))) {
+		model->out_tuning_word = tuning_word;				// Registers don't matter while in reset
+		model->out_phase = phase;
+		return;												// No change at the output; the command stays open
+	}
+	
+	// The change reaches the output after the pipeline latency
+	uint64_t output_mclk = mclk + AD9834_LATENCY_MCLK;
+	if (output_mclk < model->now_mclk) {
+		output_mclk = model->now_mclk;
+	}
+	ad9834_advance_mclk(model, output_mclk);
+	
+	if (model->num_changes < AD9834_MAX_CHANGES) {
+		ad9834_change_t* change = &model->changes[model->num_changes];
+		change->command_mclk = model->command_mclk;
+		change->output_mclk = output_mclk;
+		change->old_tuning_word = model->out_reset ? 0 : model->out_tuning_word;
+		change->new_tuning_word = reset ? 0 : tuning_word;
+		change->accumulator = model->accumulator;
+		change->phase_continuous = !reset && !model->out_reset && phase == model->out_phase;
+		change->torn = half_write && tuning_word != model->out_tuning_word;
+	}
+	model->num_changes++;
+	
+	if (reset) {
+		model->accumulator = 0;
+	}
+	model->out_tuning_word = tuning_word;
+	model->out_phase = phase;
+	model->out_reset = reset;
+	model->command_open = false;
+}
+
+// Advance the phase accumulator to time_ns with no register changes
+void ad9834_advance(ad9834_model_t* model, uint64_t time_ns)
+{
+	ad9834_advance_mclk(model, ad9834_ns_to_mclk(time_ns));
+}
+
+// Current output frequency in Hz
+double ad9834_output_freq(const ad9834_model_t* model)
+{
+	if (model->out_reset) {
+		return 0.0;
+	}
+	return (double)model->out_tuning_word * AD9834_MCLK_HZ / (1UL << 28);
+}
+
+// Print one line per recorded output change, then a summary
+void ad9834_print_changes(const ad9834_model_t* model, FILE* out)
+{
+	uint32_t recorded = model->num_changes < AD9834_MAX_CHANGES ? model->num_changes : AD9834_MAX_CHANGES;
+	uint32_t discontinuous = 0;
+	uint32_t torn = 0;
+	uint64_t max_latency = 0;
+	
+	fprintf(out, "# change  time_us  latency_ns  old_hz  new_hz  phase_deg  continuous  torn\n");
+	for (uint32_t i = 0; i < recorded; i++) {
+		const ad9834_change_t* change = &model->changes[i];
+		uint64_t latency = change->output_mclk - change->command_mclk;
+		if (latency > max_latency) {max_latency = latency;}
+		if (!change->phase_continuous) {discontinuous++;}
+		if (change->torn) {torn++;}
+		fprintf(out, "%u %.3f %.1f %.3f %.3f %.2f %s %s\n",
+			i,
+			change->output_mclk * 1e6 / AD9834_MCLK_HZ,
+			latency * 1e9 / AD9834_MCLK_HZ,
+			(double)change->old_tuning_word * AD9834_MCLK_HZ / (1UL << 28),
+			(double)change->new_tuning_word * AD9834_MCLK_HZ / (1UL << 28),
+			change->accumulator * 360.0 / (1UL << 28),
+			change->phase_continuous ? "yes" : "no",
+			change->torn ? "yes" : "no");
+	}
+	fprintf(out, "# words %u, changes %u (%u recorded), discontinuous %u, torn %u, max latency %.1f ns\n",
+		model->num_words, model->num_changes, recorded, discontinuous, torn, max_latency * 1e9 / AD9834_MCLK_HZ);
+}
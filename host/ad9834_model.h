@@ -0,0 +1,72 @@
+/*
+* Behavioral model of the Analog Devices AD9834 DDS chip, for testing the DDS code on the host.
+*
+* The model takes the 16-bit words sent by dds_send_16_bits(), each with the time at which its last bit was
+* clocked in, and decodes them the way the chip does. It tracks the frequency, phase and control registers
+* and the 28-bit phase accumulator, and records every change of the output frequency together with the
+* latency from the first word of the command to the output change and whether the phase stayed continuous.
+*/
+
+#ifndef AD9834_MODEL_H_
+#define AD9834_MODEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define AD9834_MCLK_HZ 75000000ULL		// Master clock of the DDS on the siggen board
+#define AD9834_LATENCY_MCLK 8			// MCLK cycles from a register update to the change at the output
+#define AD9834_MAX_CHANGES 1024			// Output changes recorded before further changes are only counted
+
+// Control register bits
+#define AD9834_CTRL_B28 0x2000
+#define AD9834_CTRL_HLB 0x1000
+#define AD9834_CTRL_FSEL 0x0800
+#define AD9834_CTRL_PSEL 0x0400
+#define AD9834_CTRL_PIN_SW 0x0200
+#define AD9834_CTRL_RESET 0x0100
+#define AD9834_CTRL_SLEEP1 0x0080
+#define AD9834_CTRL_SLEEP12 0x0040
+
+// One change of the output frequency or phase
+typedef struct {
+	uint64_t command_mclk;			// Time of the first word of the command that caused the change
+	uint64_t output_mclk;			// Time at which the output changed
+	uint32_t old_tuning_word;		// Tuning word driving the output before the change
+	uint32_t new_tuning_word;		// Tuning word driving the output after the change
+	uint32_t accumulator;			// Phase accumulator when the change reached the output
+	bool phase_continuous;			// False if the change reset the accumulator or jumped the phase offset
+	bool torn;						// True if only half of the new tuning word was loaded into the active register
+} ad9834_change_t;
+
+typedef struct {
+	// Chip registers
+	uint16_t control;
+	uint32_t freq[2];				// 28-bit frequency registers
+	uint16_t phase[2];				// 12-bit phase registers
+	uint16_t b28_lsb;				// 14 LSBs held until the MSB write of a B28 pair
+	int8_t b28_pending_reg;			// Frequency register waiting for its MSB write, or -1
+	
+	// Output state, as seen at the output after the pipeline latency
+	uint32_t accumulator;			// 28-bit phase accumulator
+	uint64_t now_mclk;				// Time up to which the accumulator has been advanced
+	uint32_t out_tuning_word;
+	uint16_t out_phase;
+	bool out_reset;
+	
+	// Command tracking
+	bool command_open;				// A word has been received since the last output change
+	uint64_t command_mclk;			// Time of the first word of the open command
+	
+	uint32_t num_words;
+	uint32_t num_changes;
+	ad9834_change_t changes[AD9834_MAX_CHANGES];
+} ad9834_model_t;
+
+void ad9834_init(ad9834_model_t* model);
+void ad9834_write(ad9834_model_t* model, uint64_t time_ns, uint16_t word);
+void ad9834_advance(ad9834_model_t* model, uint64_t time_ns);
+double ad9834_output_freq(const ad9834_model_t* model);
+void ad9834_print_changes(const ad9834_model_t* model, FILE* out);
+
+#endif /* AD9834_MODEL_H_ */
@@ -0,0 +1,328 @@
+/*
+* Host shim for building the firmware's DDS code on a PC. See avr_shim.h.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include "avr_shim.h"
+#include "../siggen/common.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Private variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+static const uint8_t avr_shim_dds_cs[AVR_SHIM_NUM_DDS] = {_BV(PORTB0), _BV(PORTB3)};
+
+static uint8_t avr_shim_portb_reg;
+static uint8_t avr_shim_portb_seen;			// Port B as of the last sync, for edge detection
+static uint8_t avr_shim_usidr_reg;
+static uint8_t avr_shim_usicr_reg;
+static uint16_t avr_shim_tcnt1_reg;
+static uint8_t avr_shim_tccr1b;
+static uint16_t avr_shim_ocr1a;
+static uint64_t avr_shim_timer1_cycles;		// Time up to which timer 1 has counted
+static uint16_t avr_shim_dds_shift[AVR_SHIM_NUM_DDS];
+static uint8_t avr_shim_dds_bits[AVR_SHIM_NUM_DDS];
+static uint8_t avr_shim_eecr_reg;
+static uint8_t avr_shim_eedr_reg;
+static bool avr_shim_eeprom_writing;			// EEPROM write in progress, of the address and value latched here
+static uint8_t avr_shim_eeprom_write_address;
+static uint8_t avr_shim_eeprom_write_value;
+
+// Bring timer 1 up to the current time, with the settings it has had since the last access
+static void avr_shim_timer1_update()
+{
+	uint64_t elapsed = avr_shim_cycles - avr_shim_timer1_cycles;
+	avr_shim_timer1_cycles = avr_shim_cycles;
+	if ((avr_shim_tccr1b & 0x07) == 0) {
+		return;												// Timer stopped
+	}
+	if ((avr_shim_tccr1b & 0x07) != _BV(CS10)) {
+		fprintf(stderr, "avr_shim: only timer 1 without a prescaler is emulated\n");
+		exit(2);
+	}
+	if ((avr_shim_tccr1b & _BV(WGM12)) && avr_shim_tcnt1_reg <= avr_shim_ocr1a) {
+		avr_shim_tcnt1_reg = (avr_shim_tcnt1_reg + elapsed) % ((uint32_t)avr_shim_ocr1a + 1);	// CTC with OCR1A as top
+	} else {
+		avr_shim_tcnt1_reg += (uint16_t)elapsed;
+	}
+}
+
+// Act on the last register write: USI strobes, and port B edges seen by the DDS devices
+void avr_shim_sync()
+{
+	if (avr_shim_usicr_reg & _BV(USITC)) {
+		avr_shim_portb_reg ^= _BV(PORTB7);					// USITC toggles USCK
+	}
+	if (avr_shim_usicr_reg & _BV(USICLK)) {
+		avr_shim_usidr_reg <<= 1;							// USICLK shifts the data register
+	}
+	avr_shim_usicr_reg &= ~(_BV(USITC) | _BV(USICLK));		// Strobe bits always read as zero
+	
+	uint8_t fell = avr_shim_portb_seen & ~avr_shim_portb_reg;
+	for (uint8_t i = 0; i < AVR_SHIM_NUM_DDS; i++) {
+		uint8_t cs = avr_shim_dds_cs[i];
+		if (avr_shim_portb_reg & cs) {
+			avr_shim_dds_bits[i] = 0;						// FSYNC high: a partial word is discarded
+		} else if (fell & _BV(PORTB7)) {					// DDS samples DO on the falling edge of SCLK
+			avr_shim_dds_shift[i] = (avr_shim_dds_shift[i] << 1) | (avr_shim_usidr_reg >> 7);
+			if (++avr_shim_dds_bits[i] == 16) {
+				ad9834_write(&avr_shim_dds[i], avr_shim_time_ns(), avr_shim_dds_shift[i]);
+				avr_shim_dds_bits[i] = 0;
+			}
+		}
+	}
+	avr_shim_portb_seen = avr_shim_portb_reg;
+}
+
+// Act on the last EECR write: a read strobe, or the start of a write. The firmware must set EEMPE and then
+// EEPE, in atomic erase and write mode, and must not touch the EEPROM while a write is in progress.
+static void avr_shim_eeprom_sync()
+{
+	if (avr_shim_eecr_reg & _BV(EERE)) {
+		if (avr_shim_eeprom_writing) {
+			fprintf(stderr, "avr_shim: EEPROM read while a write is in progress\n");
+			exit(2);
+		}
+		avr_shim_eedr_reg = avr_shim_eeprom[avr_shim_eear];
+		avr_shim_eecr_reg &= ~_BV(EERE);					// The read strobe clears itself
+	}
+	if ((avr_shim_eecr_reg & _BV(EEPE)) && !avr_shim_eeprom_writing) {
+		if (!(avr_shim_eecr_reg & _BV(EEMPE)) || (avr_shim_eecr_reg & (_BV(EEPM1) | _BV(EEPM0)))) {
+			fprintf(stderr, "avr_shim: EEPROM write started without EEMPE or not in erase and write mode\n");
+			exit(2);
+		}
+		avr_shim_eeprom_writing = true;
+		avr_shim_eeprom_write_address = avr_shim_eear;
+		avr_shim_eeprom_write_value = avr_shim_eedr_reg;
+		avr_shim_eecr_reg &= ~_BV(EEMPE);					// EEMPE clears itself once the write starts
+	}
+}
+
+// Every emulated register access comes through here before it reads or writes the register
+static void avr_shim_access()
+{
+	avr_shim_sync();
+	avr_shim_timer1_update();
+	avr_shim_cycles += AVR_SHIM_ACCESS_CYCLES;
+}
+
+// Run timer 1 forward to its next compare match and call the compare match ISR
+static void avr_shim_timer1_fire()
+{
+	avr_shim_sync();
+	avr_shim_timer1_update();
+	if (avr_shim_tcnt1_reg <= avr_shim_ocr1a) {
+		avr_shim_cycles += avr_shim_ocr1a - avr_shim_tcnt1_reg;
+	} else {
+		avr_shim_cycles += 0x10000UL - avr_shim_tcnt1_reg + avr_shim_ocr1a;
+	}
+	avr_shim_tcnt1_reg = (avr_shim_tccr1b & _BV(WGM12)) ? 0 : avr_shim_ocr1a;	// CTC clears the count at the match
+	avr_shim_timer1_cycles = avr_shim_cycles;
+	uint8_t sreg = avr_shim_sreg;
+	avr_shim_sreg &= ~_BV(SREG_I);							// Interrupts are disabled in the ISR
+	TIMER1_COMPA_vect();
+	avr_shim_sreg = sreg;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Register emulation
+//////////////////////////////////////////////////////////////////////////
+
+uint64_t avr_shim_cycles;
+ad9834_model_t avr_shim_dds[AVR_SHIM_NUM_DDS];
+
+volatile uint8_t avr_shim_ddrb;
+volatile uint8_t avr_shim_tccr1a;
+volatile uint8_t avr_shim_timsk;
+volatile uint8_t avr_shim_tifr;
+volatile uint8_t avr_shim_sreg;
+volatile uint8_t avr_shim_eear;
+uint8_t avr_shim_eeprom[AVR_SHIM_EEPROM_SIZE];
+uint32_t avr_shim_eeprom_writes;
+
+volatile uint8_t* avr_shim_portb()
+{
+	avr_shim_access();
+	return &avr_shim_portb_reg;
+}
+
+volatile uint8_t* avr_shim_usidr()
+{
+	avr_shim_access();
+	return &avr_shim_usidr_reg;
+}
+
+volatile uint8_t* avr_shim_usicr()
+{
+	avr_shim_access();
+	return &avr_shim_usicr_reg;
+}
+
+volatile uint16_t* avr_shim_tcnt1()
+{
+	avr_shim_access();
+	return &avr_shim_tcnt1_reg;
+}
+
+volatile uint8_t* avr_shim_tccr1b_access()
+{
+	avr_shim_access();
+	return &avr_shim_tccr1b;
+}
+
+volatile uint16_t* avr_shim_ocr1a_access()
+{
+	avr_shim_access();
+	return &avr_shim_ocr1a;
+}
+
+volatile uint8_t* avr_shim_eecr()
+{
+	avr_shim_access();
+	avr_shim_eeprom_sync();
+	return &avr_shim_eecr_reg;
+}
+
+volatile uint8_t* avr_shim_eedr()
+{
+	avr_shim_access();
+	avr_shim_eeprom_sync();
+	return &avr_shim_eedr_reg;
+}
+
+uint8_t avr_shim_eeprom_read_byte(const uint8_t* address)
+{
+	uint8_t value;
+	avr_shim_eeprom_read_block(&value, address, 1);
+	return value;
+}
+
+void avr_shim_eeprom_read_block(void* dst, const void* src, size_t size)
+{
+	uintptr_t address = (uintptr_t)src;
+	if (address >= AVR_SHIM_EEPROM_SIZE) {
+		memcpy(dst, src, size);								// EEMEM variable on the host
+		return;
+	}
+	avr_shim_eeprom_sync();
+	if (avr_shim_eeprom_writing || address + size > AVR_SHIM_EEPROM_SIZE) {
+		fprintf(stderr, "avr_shim: EEPROM read while a write is in progress or past the end\n");
+		exit(2);
+	}
+	memcpy(dst, &avr_shim_eeprom[address], size);
+}
+
+void avr_shim_delay_cycles(unsigned long cycles)
+{
+	avr_shim_sync();
+	avr_shim_cycles += cycles;
+}
+
+// Enable interrupts. A timer 1 compare match interrupt that is enabled is delivered at once; see avr/interrupt.h.
+void avr_shim_sei()
+{
+	avr_shim_sreg |= _BV(SREG_I);
+	if ((avr_shim_timsk & _BV(OCIE1A)) && (avr_shim_tccr1b & 0x07)) {
+		avr_shim_timer1_fire();
+	}
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Stand-ins for firmware modules not built on the host
+//////////////////////////////////////////////////////////////////////////
+
+// Interrupt vectors of the modules that a check program does not build. The modules' own ISRs replace these.
+__attribute__((weak)) void TIMER1_COMPA_vect(void) {}
+__attribute__((weak)) void EEPROM_READY_vect(void) {}
+
+// mul_32x32.S
+unsigned long long mul_32x32(unsigned long multiplicand, unsigned long multiplier)
+{
+	return (unsigned long long)(uint32_t)multiplicand * (uint32_t)multiplier;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public functions
+//////////////////////////////////////////////////////////////////////////
+
+// Power up the MCU and the DDS devices. Registers are cleared, the DDS models start in reset and the EEPROM
+// contents are kept, apart from a write that was in progress, which is lost. Simulated time carries on, so
+// that model times never go backwards.
+void avr_shim_power_up()
+{
+	avr_shim_portb_reg = 0;
+	avr_shim_portb_seen = 0;
+	avr_shim_usidr_reg = 0;
+	avr_shim_usicr_reg = 0;
+	avr_shim_tcnt1_reg = 0;
+	avr_shim_timer1_cycles = avr_shim_cycles;
+	avr_shim_ddrb = 0;
+	avr_shim_tccr1a = 0;
+	avr_shim_tccr1b = 0;
+	avr_shim_ocr1a = 0;
+	avr_shim_timsk = 0;
+	avr_shim_tifr = 0;
+	avr_shim_sreg = 0;
+	avr_shim_eecr_reg = 0;
+	avr_shim_eedr_reg = 0;
+	avr_shim_eear = 0;
+	avr_shim_eeprom_writing = false;
+	for (uint8_t i = 0; i < AVR_SHIM_NUM_DDS; i++) {
+		ad9834_init(&avr_shim_dds[i]);
+		ad9834_advance(&avr_shim_dds[i], avr_shim_time_ns());
+		avr_shim_dds_shift[i] = 0;
+		avr_shim_dds_bits[i] = 0;
+	}
+}
+
+// Simulated time in nanoseconds
+uint64_t avr_shim_time_ns()
+{
+	return avr_shim_cycles * 1000000000ULL / F_CPU;
+}
+
+// Run timer 1 to its next compare match and call TIMER1_COMPA_vect, as the hardware would if the interrupt
+// is enabled. Returns false, and does nothing, if the timer is stopped or the interrupt is disabled.
+bool avr_shim_timer1_compare()
+{
+	if (!(avr_shim_timsk & _BV(OCIE1A)) || !(avr_shim_tccr1b & 0x07)) {
+		return false;
+	}
+	avr_shim_timer1_fire();
+	return true;
+}
+
+// Erase the emulated EEPROM to all 0xFF
+void avr_shim_eeprom_erase()
+{
+	memset(avr_shim_eeprom, 0xFF, sizeof(avr_shim_eeprom));
+}
+
+// The EEPROM ready interrupt condition: finish the write in progress, if there is one, taking the time a
+// write takes, and then call EEPROM_READY_vect if the interrupt is enabled, as the hardware does whenever the
+// EEPROM is idle. Returns false if the interrupt is disabled.
+bool avr_shim_eeprom_ready()
+{
+	avr_shim_sync();
+	avr_shim_eeprom_sync();
+	if (avr_shim_eeprom_writing) {
+		avr_shim_cycles += AVR_SHIM_EEPROM_WRITE_CYCLES;
+		avr_shim_eeprom[avr_shim_eeprom_write_address] = avr_shim_eeprom_write_value;
+		avr_shim_eeprom_writes++;
+		avr_shim_eeprom_writing = false;
+		avr_shim_eecr_reg &= ~_BV(EEPE);
+	}
+	if (!(avr_shim_eecr_reg & _BV(EERIE))) {
+		return false;
+	}
+	uint8_t sreg = avr_shim_sreg;
+	avr_shim_sreg &= ~_BV(SREG_I);							// Interrupts are disabled in the ISR
+	EEPROM_READY_vect();
+	avr_shim_sreg = sreg;
+	return true;
+}
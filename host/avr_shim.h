@@ -0,0 +1,43 @@
+/*
+* Host shim for building the firmware's DDS code on a PC and checking it against the AD9834 model.
+*
+* The shim stands in for the ATtiny4313 registers used by dds.c, chirp.c and ee.c (see avr_shim/avr/io.h) and
+* for mul_32x32.S. ee_shim.c stands in for ee.c in check programs that build dds.c. The shim emulates the USI in three-wire mode: each USITC write toggles USCK on PB7, each USICLK
+* write shifts USIDR, and on every falling edge of USCK each DDS whose chip select is low shifts in the top bit
+* of USIDR. After 16 bits the word goes to that device's model, stamped with the simulated time.
+*
+* Time is counted in system clock cycles. Each register access counts AVR_SHIM_ACCESS_CYCLES and each
+* __builtin_avr_delay_cycles() its argument; other instructions are not counted, so times are only a rough
+* lower bound. Timer 1 counts those cycles when it is clocked (no prescaler only).
+*
+* The EEPROM is an array written through EEAR, EEDR and EECR. A write started by the firmware completes, and
+* the EEPROM ready interrupt is delivered, only when the check program calls avr_shim_eeprom_ready(), so the
+* check decides how far the EEPROM gets between firmware calls.
+*/
+
+#ifndef AVR_SHIM_H_
+#define AVR_SHIM_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "ad9834_model.h"
+
+#define AVR_SHIM_ACCESS_CYCLES 2		// Cycles counted per register access, as for sbi or a load and out
+#define AVR_SHIM_NUM_DDS 2				// DDS devices emulated: chip select on PB0 and PB3, as in dds.c
+#define AVR_SHIM_EEPROM_SIZE 256		// ATtiny4313 EEPROM bytes
+#define AVR_SHIM_EEPROM_WRITE_CYCLES (F_CPU / 10000UL * 34)	// 3.4 ms erase and write
+
+extern uint64_t avr_shim_cycles;						// Simulated time in system clock cycles
+extern ad9834_model_t avr_shim_dds[AVR_SHIM_NUM_DDS];	// Model of each DDS device
+extern uint8_t avr_shim_eeprom[AVR_SHIM_EEPROM_SIZE];	// Emulated EEPROM contents
+extern uint32_t avr_shim_eeprom_writes;					// EEPROM byte writes completed
+
+void avr_shim_power_up();
+void avr_shim_sync();
+uint64_t avr_shim_time_ns();
+bool avr_shim_timer1_compare();
+void avr_shim_eeprom_erase();
+bool avr_shim_eeprom_ready();
+void ee_shim_erase();					// ee_shim.c
+
+#endif /* AVR_SHIM_H_ */
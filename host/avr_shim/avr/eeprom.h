@@ -0,0 +1,23 @@
+/*
+* Host stand-in for <avr/eeprom.h>. See avr_shim.h.
+*
+* Addresses below 256 read the emulated EEPROM, as ee.c does with the addresses of its ring slots. Other
+* addresses are EEMEM variables, which are ordinary variables on the host and are read directly. They start
+* out zeroed rather than erased, which is still not a valid calibration or saved state.
+*/
+
+#ifndef AVR_SHIM_EEPROM_H_
+#define AVR_SHIM_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t avr_shim_eeprom_read_byte(const uint8_t* address);
+void avr_shim_eeprom_read_block(void* dst, const void* src, size_t size);
+
+#define eeprom_read_byte(address) avr_shim_eeprom_read_byte(address)
+#define eeprom_read_block(dst, src, size) avr_shim_eeprom_read_block((dst), (src), (size))
+
+#endif /* AVR_SHIM_EEPROM_H_ */
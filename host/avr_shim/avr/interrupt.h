@@ -0,0 +1,23 @@
+/*
+* Host stand-in for <avr/interrupt.h>. See avr_shim.h.
+*
+* An ISR is an ordinary function that the shim or the check program calls. There is no concurrency on the
+* host, so sei() delivers a pending timer 1 compare match at once, at the time the match would happen;
+* otherwise code that enables interrupts and then waits for the ISR would spin forever.
+*/
+
+#ifndef AVR_SHIM_INTERRUPT_H_
+#define AVR_SHIM_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void)
+
+void TIMER1_COMPA_vect(void);
+void EEPROM_READY_vect(void);
+void avr_shim_sei();
+
+#define sei() avr_shim_sei()
+#define cli() (SREG &= ~_BV(SREG_I))
+
+#endif /* AVR_SHIM_INTERRUPT_H_ */
@@ -0,0 +1,84 @@
+/*
+* Host stand-in for <avr/io.h>, for building the firmware's DDS code on a PC. See avr_shim.h.
+*
+* Only the registers and bits used by dds.c, chirp.c, lcd.c, bcd.c and ee.c are defined, with their ATtiny4313
+* bit numbers. PORTB, USIDR, USICR, TCNT1, TCCR1B, OCR1A, EECR and EEDR go through accessor functions so that
+* the shim sees every access and can emulate the USI clocking, timer 1 and the EEPROM. The other registers are
+* plain variables.
+*/
+
+#ifndef AVR_SHIM_IO_H_
+#define AVR_SHIM_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+volatile uint8_t* avr_shim_portb();
+volatile uint8_t* avr_shim_usidr();
+volatile uint8_t* avr_shim_usicr();
+volatile uint16_t* avr_shim_tcnt1();
+volatile uint8_t* avr_shim_tccr1b_access();
+volatile uint16_t* avr_shim_ocr1a_access();
+volatile uint8_t* avr_shim_eecr();
+volatile uint8_t* avr_shim_eedr();
+void avr_shim_delay_cycles(unsigned long cycles);
+
+extern volatile uint8_t avr_shim_ddrb;
+extern volatile uint8_t avr_shim_tccr1a;
+extern volatile uint8_t avr_shim_timsk;
+extern volatile uint8_t avr_shim_tifr;
+extern volatile uint8_t avr_shim_sreg;
+extern volatile uint8_t avr_shim_eear;
+
+#define PORTB (*avr_shim_portb())
+#define USIDR (*avr_shim_usidr())
+#define USICR (*avr_shim_usicr())
+#define TCNT1 (*avr_shim_tcnt1())
+#define DDRB avr_shim_ddrb
+#define TCCR1A avr_shim_tccr1a
+#define TCCR1B (*avr_shim_tccr1b_access())
+#define OCR1A (*avr_shim_ocr1a_access())
+#define TIMSK avr_shim_timsk
+#define TIFR avr_shim_tifr
+#define SREG avr_shim_sreg
+#define EECR (*avr_shim_eecr())
+#define EEDR (*avr_shim_eedr())
+#define EEAR avr_shim_eear
+
+// Port B
+#define PORTB0 0
+#define PORTB1 1
+#define PORTB3 3
+#define PORTB7 7
+#define DDB1 1
+
+// USICR
+#define USITC 0
+#define USICLK 1
+
+// TCCR1B
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define WGM12 3
+
+// TIMSK and TIFR
+#define OCIE1A 6
+#define OCF1A 6
+
+// SREG
+#define SREG_I 7
+
+// EECR
+#define EERE 0
+#define EEPE 1
+#define EEMPE 2
+#define EERIE 3
+#define EEPM0 4
+#define EEPM1 5
+
+// The firmware busy-waits with this avr-gcc builtin; on the host it only advances the cycle count
+#define __builtin_avr_delay_cycles(cycles) avr_shim_delay_cycles(cycles)
+
+#endif /* AVR_SHIM_IO_H_ */
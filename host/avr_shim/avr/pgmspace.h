@@ -0,0 +1,15 @@
+/*
+* Host stand-in for <avr/pgmspace.h>. Program memory is ordinary memory on the host.
+*/
+
+#ifndef AVR_SHIM_PGMSPACE_H_
+#define AVR_SHIM_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte(p) (*(const uint8_t*)(p))
+#define pgm_read_word(p) (*(const uint16_t*)(p))
+#define pgm_read_dword(p) (*(const uint32_t*)(p))
+
+#endif /* AVR_SHIM_PGMSPACE_H_ */
@@ -0,0 +1,12 @@
+/*
+* Host stand-in for <util/atomic.h>. Nothing can interrupt the host build, so the block just runs once.
+*/
+
+#ifndef AVR_SHIM_ATOMIC_H_
+#define AVR_SHIM_ATOMIC_H_
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+#define ATOMIC_BLOCK(type) for (int atomic_once = 1; atomic_once; atomic_once = 0)
+
+#endif /* AVR_SHIM_ATOMIC_H_ */
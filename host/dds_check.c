@@ -0,0 +1,300 @@
+/*
+* Check the firmware's DDS code off-target: dds.c and chirp.c are built for the host against the shim in
+* avr_shim.c, so every word they send goes through the emulated USI into the AD9834 model. The checks drive
+* the code the way the firmware does and assert what reaches the DDS output: the frequency, phase
+* continuity, no torn tuning words, and alternation between the two register sets.
+*
+* Build, from the host directory:
+*   gcc -std=gnu99 -O2 -Wall -fpack-struct -Wno-pointer-to-int-cast -DCHIRP_ENABLE=1 -Iavr_shim -I../siggen -o dds_check
+*       dds_check.c avr_shim.c ee_shim.c ad9834_model.c ../siggen/dds.c ../siggen/chirp.c ../siggen/lcd.c ../siggen/bcd.c -lm
+* -fpack-struct lays structs out without padding, as avr-gcc does, so the saved state's check byte covers the
+* same bytes as on the target. Build it a second time with -DDDS_NUM_DEVICES=2 to check an I/Q pair, with the
+* second device on PB3.
+* Usage: dds_check [-v]
+* Exits with status 1 if any check fails. With -v, prints every output change seen by the model.
+*/
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include "avr_shim.h"
+#include "common.h"
+#include "dds.h"
+#include "chirp.h"
+
+#if !CHIRP_ENABLE
+#error "Build dds_check with -DCHIRP_ENABLE=1, so that chirp mode is built"
+#endif
+
+#define CHECK_FREQ_TOLERANCE_HZ 0.5		// More than the 0.28 Hz tuning resolution at 75 MHz
+#define CHECK_CHIRP_RATE 10000UL		// Chirp updates per second
+#define CHECK_CHIRP_TICKS 40			// Chirp ticks checked, enough to wrap around the sweep
+
+static int failures = 0;
+static bool verbose = false;
+static ad9834_model_t* const model = &avr_shim_dds[0];
+
+#define CHECK(condition, ...) do { \
+	if (!(condition)) { \
+		failures++; \
+		printf("FAIL %s:%d: ", __func__, __LINE__); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+	} \
+} while (0)
+
+// Register set the model's control register selects, from FSEL
+static uint8_t check_selected_set()
+{
+	return (model->control & AD9834_CTRL_FSEL) ? 1 : 0;
+}
+
+// Most recent output change
+static const ad9834_change_t* check_last_change()
+{
+	return &model->changes[model->num_changes - 1];
+}
+
+// Let the output run for a while, so that the accumulator moves between changes
+static void check_run_us(unsigned long us)
+{
+	avr_shim_delay_cycles(F_CPU / 1000000UL * us);
+	ad9834_advance(model, avr_shim_time_ns());
+}
+
+// Change the frequency through the firmware and check that exactly one clean output change results, on the
+// register set that was free, leaving the old tuning word in the other set
+static void check_frequency_change(unsigned long freq, bool from_reset)
+{
+	uint32_t changes = model->num_changes;
+	uint8_t set = dds_devices[0].register_set;
+	unsigned long old_word = dds_devices[0].tuning_word;
+	unsigned long word = dds_calc_tuning_word_integral(freq);
+
+	dds_set_frequency_integral(freq);
+	avr_shim_sync();
+	CHECK(model->num_changes == changes + 1, "%lu Hz: %u output changes, expected 1", freq, model->num_changes - changes);
+	if (model->num_changes != changes + 1) {
+		return;
+	}
+	const ad9834_change_t* change = check_last_change();
+	CHECK(change->new_tuning_word == word, "%lu Hz: output tuning word %u, expected %lu", freq, change->new_tuning_word, word);
+	CHECK(fabs(ad9834_output_freq(model) - freq) < CHECK_FREQ_TOLERANCE_HZ, "%lu Hz: output at %.3f Hz", freq, ad9834_output_freq(model));
+	CHECK(!change->torn, "%lu Hz: torn update", freq);
+	CHECK(change->phase_continuous != from_reset, "%lu Hz: phase continuous %d", freq, change->phase_continuous);
+	CHECK(check_selected_set() == set, "%lu Hz: output on register set %u, expected %u", freq, check_selected_set(), set);
+	CHECK(model->freq[set ^ 1] == old_word, "%lu Hz: other register set changed", freq);
+	CHECK(dds_devices[0].register_set == (set ^ 1), "%lu Hz: next register set not toggled", freq);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Checks
+//////////////////////////////////////////////////////////////////////////
+
+// Power up with nothing saved: the DDS must be left in reset with no output, and the first frequency change
+// must release it.
+static void check_initialize()
+{
+	avr_shim_power_up();
+	ee_shim_erase();
+	dds_initialize();
+	avr_shim_sync();
+	CHECK(model->out_reset, "output not in reset after dds_initialize()");
+	CHECK(model->num_changes == 0, "%u output changes during dds_initialize()", model->num_changes);
+	CHECK(model->control & AD9834_CTRL_B28, "B28 not set");
+	CHECK(!(model->control & AD9834_CTRL_PIN_SW), "not under software control");
+	CHECK(model->freq[0] == 0 && model->freq[1] == 0 && model->phase[0] == 0 && model->phase[1] == 0, "registers not zeroed");
+
+	check_frequency_change(1000000, true);
+}
+
+// A sequence of frequency changes must alternate register sets, each change landing in one piece
+static void check_frequency_changes()
+{
+	static const unsigned long freqs[] = {1000100, 2000000, 100000, 100001, 12345678, 999999, 30000000, 1000000};
+	for (uint8_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+		check_run_us(50);
+		check_frequency_change(freqs[i], false);
+	}
+}
+
+// A chirp must retune once per tick, in steps of the step frequency that wrap around at the stop frequency,
+// alternating register sets, with no underruns while the producer keeps up. When the producer stops, the
+// output must stay put and the ticks must be counted as underruns. Normal frequency changes after the chirp
+// must carry on the alternation.
+static void check_chirp()
+{
+	const unsigned long start = 100000;
+	const unsigned long stop = 110000;
+	const unsigned long step = 500;
+	unsigned long start_word = dds_calc_tuning_word_integral(start);
+	unsigned long stop_word = dds_calc_tuning_word_integral(stop);
+	unsigned long step_word = dds_calc_tuning_word_integral(step);
+	unsigned long word = start_word;
+	uint64_t period_ns = 1000000000ULL / CHECK_CHIRP_RATE;
+	uint64_t previous_mclk = 0;
+
+	unsigned long max_rate = chirp_max_update_rate();
+	CHECK(model->num_changes == 0 || !check_last_change()->torn, "chirp_max_update_rate() disturbed the output");
+	uint32_t changes = model->num_changes;
+	CHECK(max_rate >= CHECK_CHIRP_RATE, "chirp_max_update_rate() is only %lu", max_rate);
+	CHECK(!chirp_start(start, stop, step, max_rate + 1), "chirp_start() accepted more than the maximum rate");
+	CHECK(model->num_changes == changes, "measuring the chirp ISR changed the output");
+	uint8_t set = dds_devices[0].register_set;					// The chirp starts on the free register set
+	if (!chirp_start(start, stop, step, CHECK_CHIRP_RATE)) {
+		CHECK(false, "chirp_start() failed");
+		return;
+	}
+
+	// chirp_start() enables interrupts, which delivers the first tick at once on the host
+	for (uint16_t tick = 0; tick < CHECK_CHIRP_TICKS; tick++) {
+		if (tick > 0) {
+			chirp_fill();
+			avr_shim_timer1_compare();
+		}
+		avr_shim_sync();
+		CHECK(model->num_changes == changes + 1, "tick %u: %u output changes, expected 1", tick, model->num_changes - changes);
+		changes = model->num_changes;
+		const ad9834_change_t* change = check_last_change();
+		CHECK(change->new_tuning_word == word, "tick %u: tuning word %u, expected %lu", tick, change->new_tuning_word, word);
+		CHECK(change->phase_continuous && !change->torn, "tick %u: discontinuous or torn", tick);
+		CHECK(check_selected_set() == set, "tick %u: output on register set %u, expected %u", tick, check_selected_set(), set);
+		if (tick > 0) {
+			uint64_t spacing_ns = (change->output_mclk - previous_mclk) * 1000000000ULL / AD9834_MCLK_HZ;
+			CHECK(spacing_ns + 100 > period_ns && spacing_ns < period_ns + 100, "tick %u: %llu ns since the last update", tick,
+				(unsigned long long)spacing_ns);
+		}
+		previous_mclk = change->output_mclk;
+		set ^= 1;
+		word += step_word;
+		if (word > stop_word) {word = start_word;}
+	}
+	CHECK(chirp_underruns() == 0, "%u underruns while the producer kept up", chirp_underruns());
+
+	// Let the ring run dry
+	uint8_t underrun_ticks = 0;
+	while (underrun_ticks < 3) {
+		avr_shim_timer1_compare();
+		avr_shim_sync();
+		if (model->num_changes == changes) {
+			underrun_ticks++;
+		}
+		changes = model->num_changes;
+	}
+	CHECK(chirp_underruns() == 3, "%u underruns counted, expected 3", chirp_underruns());
+
+	chirp_stop();
+	CHECK(dds_devices[0].tuning_word == check_last_change()->new_tuning_word, "chirp_stop() lost the output tuning word");
+	CHECK(dds_devices[0].register_set != check_selected_set(), "chirp_stop() left the active register set as the next one");
+	check_frequency_change(1000000, false);
+	check_frequency_change(2000000, false);
+}
+
+// Save the output, power cycle, and check that the output comes straight back up at the saved frequency.
+// The script tests from the board bring-up must still give one clean change each from reset.
+static void check_restore()
+{
+	check_frequency_change(1234567, false);
+	CHECK(dds_save_state(1234567), "dds_save_state() failed");
+	unsigned long word = dds_devices[0].tuning_word;
+	uint8_t set = dds_devices[0].register_set;
+
+	check_run_us(1000);
+	avr_shim_power_up();
+	dds_initialize();
+	avr_shim_sync();
+	CHECK(model->num_changes == 1, "%u output changes while restoring, expected 1", model->num_changes);
+	if (model->num_changes == 1) {
+		const ad9834_change_t* change = check_last_change();
+		CHECK(change->new_tuning_word == word, "restored tuning word %u, expected %lu", change->new_tuning_word, word);
+		uint64_t latency_mclk = change->output_mclk - change->command_mclk;
+		uint64_t burst_mclk = avr_shim_time_ns() * AD9834_MCLK_HZ / 1000000000ULL - change->command_mclk;
+		CHECK(latency_mclk * 8 <= burst_mclk * 5 + 8 * AD9834_LATENCY_MCLK, "reset released %.2f us into a %.2f us burst, "
+			"expected after the fifth of eight words", latency_mclk * 1e6 / AD9834_MCLK_HZ, burst_mclk * 1e6 / AD9834_MCLK_HZ);
+		printf("restore: output at %.3f Hz %.2f us after the first word\n", ad9834_output_freq(model), latency_mclk * 1e6 / AD9834_MCLK_HZ);
+	}
+	CHECK(dds_restored_display_value() == 1234567, "restored display value %u", dds_restored_display_value());
+	CHECK(dds_devices[0].register_set == set, "next register set %u after restore, expected %u", dds_devices[0].register_set, set);
+	check_run_us(50);
+	check_frequency_change(1000000, false);
+
+	avr_shim_power_up();
+	dds_test3();
+	avr_shim_sync();
+	CHECK(model->num_changes == 1 && check_last_change()->old_tuning_word == 0, "dds_test3(): %u changes", model->num_changes);
+	CHECK(fabs(ad9834_output_freq(model) - 800000) < 2, "dds_test3(): output at %.3f Hz", ad9834_output_freq(model));
+}
+
+#if DDS_NUM_DEVICES > 1
+// An I/Q pair from dds_test7(): both outputs must restart on the same clock edge at the same frequency, with
+// device 1 leading by the 1024 (90 degree) phase offset. Once device 0 is retuned on its own, the devices are
+// out of register set step and every coherent update must be refused without sending anything, until device 0
+// is changed once more.
+static void check_iq()
+{
+	ad9834_model_t* q_model = &avr_shim_dds[1];
+	avr_shim_power_up();
+	ee_shim_erase();
+	dds_initialize();
+	dds_test7();
+	avr_shim_sync();
+	unsigned long word = dds_calc_tuning_word_integral(1000000);
+	CHECK(!model->out_reset && !q_model->out_reset, "outputs still in reset after dds_test7()");
+	CHECK(model->num_changes > 0 && q_model->num_changes > 0, "no output changes after dds_test7()");
+	if (model->num_changes == 0 || q_model->num_changes == 0) {
+		return;
+	}
+	const ad9834_change_t* i_change = &model->changes[model->num_changes - 1];
+	const ad9834_change_t* q_change = &q_model->changes[q_model->num_changes - 1];
+	CHECK(i_change->output_mclk == q_change->output_mclk, "outputs changed %lld MCLK cycles apart",
+		(long long)(q_change->output_mclk - i_change->output_mclk));
+	CHECK(i_change->new_tuning_word == word && q_change->new_tuning_word == word, "tuning words %u and %u, expected %lu",
+		i_change->new_tuning_word, q_change->new_tuning_word, word);
+	CHECK(i_change->accumulator == q_change->accumulator, "accumulators %u and %u at the restart",
+		i_change->accumulator, q_change->accumulator);
+	CHECK(model->out_phase == 0 && q_model->out_phase == 1024, "phases %u and %u, expected 0 and 1024",
+		model->out_phase, q_model->out_phase);
+	CHECK(dds_devices[0].register_set == dds_devices[1].register_set, "devices out of step after dds_test7()");
+	
+	check_run_us(50);
+	check_frequency_change(1100000, false);
+	uint32_t i_words = model->num_words;
+	uint32_t q_words = q_model->num_words;
+	CHECK(!dds_preload(0, word, 0), "dds_preload() of device 0 accepted out of step");
+	CHECK(!dds_preload(1, word, 1024), "dds_preload() of device 1 accepted out of step");
+	CHECK(!dds_commit(), "dds_commit() accepted out of step");
+	CHECK(!dds_restart_coherent(), "dds_restart_coherent() accepted out of step");
+	avr_shim_sync();
+	CHECK(model->num_words == i_words && q_model->num_words == q_words, "words sent while out of step");
+	
+	dds_device_change_frequency(&dds_devices[0], dds_devices[0].tuning_word);	// Back into step
+	word = dds_calc_tuning_word_integral(1200000);
+	CHECK(dds_preload(0, word, 0) && dds_preload(1, word, 1024), "dds_preload() refused back in step");
+	CHECK(dds_commit(), "dds_commit() refused back in step");
+	avr_shim_sync();
+	CHECK(model->changes[model->num_changes - 1].output_mclk == q_model->changes[q_model->num_changes - 1].output_mclk,
+		"outputs changed apart after dds_commit()");
+	CHECK(model->out_tuning_word == word && q_model->out_tuning_word == word, "tuning words %u and %u after dds_commit()",
+		model->out_tuning_word, q_model->out_tuning_word);
+}
+#endif
+
+int main(int argc, char** argv)
+{
+	verbose = argc > 1 && strcmp(argv[1], "-v") == 0;
+
+	check_initialize();
+	check_frequency_changes();
+	check_chirp();
+	if (verbose) {
+		ad9834_print_changes(model, stdout);
+	}
+	check_restore();
+#if DDS_NUM_DEVICES > 1
+	check_iq();
+#endif
+
+	printf("%s: %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,210 @@
+/*
+* Check the firmware's asynchronous EEPROM writes off-target: ee.c is built for the host against the EEPROM
+* emulated in avr_shim.c. The check decides when each EEPROM write finishes and the ready interrupt runs, so
+* it can look at the queue and the wear-leveled ring at the points that matter: while a slot is still queued
+* in full, once the interrupt has taken its first byte, and after a power failure part way through a slot.
+*
+* Build, from the host directory:
+*   gcc -std=gnu99 -O2 -Wall -Wno-pointer-to-int-cast -Wno-int-to-pointer-cast -Iavr_shim -I../siggen -o ee_check ee_check.c
+*       avr_shim.c ad9834_model.c ../siggen/ee.c
+* Usage: ee_check
+* Exits with status 1 if any check fails.
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include "avr_shim.h"
+#include "common.h"
+#include "ee.h"
+
+#define CHECK_RING_BASE 16				// EEPROM address of the ring
+#define CHECK_RING_SLOTS 4
+#define CHECK_SLOT_SIZE (1 + sizeof(uint32_t))
+#define CHECK_OTHER_ADDRESS 100			// EEPROM address of writes unrelated to the ring
+
+// ee.c's queue, which is in RAM and so is lost at power-up
+extern volatile uint8_t ee_queue_tail;
+extern volatile uint8_t ee_queue_count;
+
+static int failures = 0;
+static ee_ring_t ring;
+
+#define CHECK(condition, ...) do { \
+	if (!(condition)) { \
+		failures++; \
+		printf("FAIL %s:%d: ", __func__, __LINE__); \
+		printf(__VA_ARGS__); \
+		printf("\n"); \
+	} \
+} while (0)
+
+// Power up and find the newest slot of the ring, as the firmware does at startup
+static void check_power_up()
+{
+	avr_shim_power_up();
+	ee_queue_tail = 0;
+	ee_queue_count = 0;
+	ee_ring_initialize(&ring, CHECK_RING_BASE, CHECK_SLOT_SIZE, CHECK_RING_SLOTS);
+}
+
+// Let the EEPROM finish everything that is queued
+static void check_drain()
+{
+	while (avr_shim_eeprom_ready()) {}
+	CHECK(!ee_busy(), "still busy after draining the queue");
+}
+
+// Sequence byte and payload of a slot, as written in the EEPROM
+static uint8_t check_slot_seq(uint8_t slot)
+{
+	return avr_shim_eeprom[CHECK_RING_BASE + slot * CHECK_SLOT_SIZE];
+}
+
+static uint32_t check_slot_payload(uint8_t slot)
+{
+	uint32_t payload;
+	memcpy(&payload, &avr_shim_eeprom[CHECK_RING_BASE + slot * CHECK_SLOT_SIZE + 1], sizeof(payload));
+	return payload;
+}
+
+static void check_slot_write(uint8_t slot, uint8_t seq, uint32_t payload)
+{
+	avr_shim_eeprom[CHECK_RING_BASE + slot * CHECK_SLOT_SIZE] = seq;
+	memcpy(&avr_shim_eeprom[CHECK_RING_BASE + slot * CHECK_SLOT_SIZE + 1], &payload, sizeof(payload));
+}
+
+// Power up and check that the ring comes back with the expected newest slot and payload
+static void check_restored(uint8_t newest, uint8_t seq, uint32_t payload)
+{
+	check_power_up();
+	uint32_t restored;
+	ee_ring_read(&ring, &restored);
+	CHECK(ring.newest == newest && ring.seq == seq, "newest slot %u seq %u after power-up, expected slot %u seq %u",
+		ring.newest, ring.seq, newest, seq);
+	CHECK(restored == payload, "restored payload 0x%08X, expected 0x%08X", restored, payload);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Checks
+//////////////////////////////////////////////////////////////////////////
+
+// While the EEPROM is busy with another write, repeated ring writes must coalesce into the one queued slot,
+// costing one EEPROM write per byte
+static void check_coalesce()
+{
+	avr_shim_eeprom_erase();
+	check_power_up();
+	CHECK(ring.newest == 0 && ring.seq == 0xFF, "erased ring: newest slot %u seq %u", ring.newest, ring.seq);
+
+	CHECK(ee_write_byte(CHECK_OTHER_ADDRESS, 0x5A), "ee_write_byte() failed");
+	avr_shim_eeprom_ready();								// The EEPROM starts on the unrelated byte
+	uint32_t writes = avr_shim_eeprom_writes;
+	static const uint32_t payloads[] = {0x11223344, 0x22334455, 0x33445566};
+	for (uint8_t i = 0; i < 3; i++) {
+		CHECK(ee_ring_write(&ring, &payloads[i]), "ee_ring_write() %u failed", i);
+		CHECK(ring.newest == 1, "write %u went to slot %u, expected slot 1", i, ring.newest);
+	}
+	check_drain();
+	CHECK(avr_shim_eeprom_writes - writes == 1 + CHECK_SLOT_SIZE, "%u EEPROM writes, expected %u",
+		avr_shim_eeprom_writes - writes, 1 + (unsigned)CHECK_SLOT_SIZE);
+	CHECK(check_slot_seq(1) == 0 && check_slot_payload(1) == payloads[2], "slot 1 holds seq %u payload 0x%08X",
+		check_slot_seq(1), check_slot_payload(1));
+	CHECK(check_slot_seq(2) == 0xFF && check_slot_payload(2) == 0xFFFFFFFF, "slot 2 written");
+	CHECK(avr_shim_eeprom[CHECK_OTHER_ADDRESS] == 0x5A, "unrelated byte not written");
+	check_restored(1, 0, payloads[2]);
+}
+
+// Once the interrupt has taken the first byte of the queued slot, a new write must go to the next slot, so the
+// partly written slot is completed as it was queued
+static void check_no_coalesce_once_started()
+{
+	check_power_up();
+	uint8_t newest = ring.newest;
+	uint8_t seq = ring.seq;
+	uint32_t first = 0x44556677;
+	uint32_t second = 0x55667788;
+	CHECK(ee_ring_write(&ring, &first), "ee_ring_write() failed");
+	avr_shim_eeprom_ready();								// The EEPROM starts on the first payload byte
+	CHECK(ee_ring_write(&ring, &second), "ee_ring_write() failed");
+	uint8_t first_slot = (newest + 1) % CHECK_RING_SLOTS;
+	uint8_t second_slot = (newest + 2) % CHECK_RING_SLOTS;
+	CHECK(ring.newest == second_slot, "second write went to slot %u, expected slot %u", ring.newest, second_slot);
+	check_drain();
+	CHECK(check_slot_seq(first_slot) == (uint8_t)(seq + 1) && check_slot_payload(first_slot) == first,
+		"slot %u holds seq %u payload 0x%08X", first_slot, check_slot_seq(first_slot), check_slot_payload(first_slot));
+	CHECK(check_slot_seq(second_slot) == (uint8_t)(seq + 2) && check_slot_payload(second_slot) == second,
+		"slot %u holds seq %u payload 0x%08X", second_slot, check_slot_seq(second_slot), check_slot_payload(second_slot));
+	check_restored(second_slot, seq + 2, second);
+}
+
+// A block queued elsewhere in the EEPROM must not be taken for a queued slot: the ring write must go to a new
+// slot and leave the last committed slot alone
+static void check_unrelated_block()
+{
+	check_power_up();
+	uint8_t newest = ring.newest;
+	uint8_t seq = ring.seq;
+	uint32_t committed = check_slot_payload(newest);
+	static const uint8_t block[4] = {1, 2, 3, 4};
+	uint32_t payload = 0x66778899;
+	CHECK(ee_write_block(CHECK_OTHER_ADDRESS, block, sizeof(block)), "ee_write_block() failed");
+	CHECK(ee_ring_write(&ring, &payload), "ee_ring_write() failed");
+	uint8_t slot = (newest + 1) % CHECK_RING_SLOTS;
+	CHECK(ring.newest == slot, "write went to slot %u, expected slot %u", ring.newest, slot);
+	check_drain();
+	CHECK(check_slot_seq(newest) == seq && check_slot_payload(newest) == committed, "committed slot %u changed", newest);
+	CHECK(memcmp(&avr_shim_eeprom[CHECK_OTHER_ADDRESS], block, sizeof(block)) == 0, "unrelated block not written");
+	check_restored(slot, seq + 1, payload);
+}
+
+// Sequence numbers wrap around from 255 to 0 within the ring, and the newest slot must still be found
+static void check_sequence_wrap()
+{
+	avr_shim_eeprom_erase();
+	check_slot_write(0, 0xFE, 0x01010101);
+	check_slot_write(1, 0xFF, 0x02020202);
+	check_slot_write(2, 0x00, 0x03030303);
+	check_slot_write(3, 0xFD, 0x04040404);
+	check_restored(2, 0x00, 0x03030303);
+
+	uint32_t payload = 0x05050505;
+	CHECK(ee_ring_write(&ring, &payload), "ee_ring_write() failed");
+	check_drain();
+	check_restored(3, 0x01, payload);
+
+	payload = 0x06060606;
+	CHECK(ee_ring_write(&ring, &payload), "ee_ring_write() failed");
+	check_drain();
+	check_restored(0, 0x02, payload);
+}
+
+// Power fails after the payload of a new slot is written but before its sequence byte is: the previous slot
+// must come back
+static void check_power_fail()
+{
+	check_power_up();
+	uint8_t newest = ring.newest;
+	uint8_t seq = ring.seq;
+	uint32_t committed = check_slot_payload(newest);
+	uint32_t payload = 0x778899AA;
+	CHECK(ee_ring_write(&ring, &payload), "ee_ring_write() failed");
+	for (uint8_t i = 0; i < CHECK_SLOT_SIZE; i++) {
+		avr_shim_eeprom_ready();							// The last call starts the sequence byte
+	}
+	uint8_t slot = (newest + 1) % CHECK_RING_SLOTS;
+	CHECK(check_slot_payload(slot) == payload, "payload not written before the sequence byte");
+	check_restored(newest, seq, committed);
+}
+
+int main(int argc, char** argv)
+{
+	check_coalesce();
+	check_no_coalesce_once_started();
+	check_unrelated_block();
+	check_sequence_wrap();
+	check_power_fail();
+
+	printf("%s: %d failed checks\n", failures ? "FAIL" : "PASS", failures);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,69 @@
+/*
+* Stand-in for ee.c, for check programs that build dds.c on the host. The EEMEM variables in dds.c are host
+* variables there, so their addresses can't go through the real ee.c, which takes 8-bit EEPROM addresses.
+* Only the newest payload of a ring is kept, and it is written at once. Other writes are dropped.
+*
+* ee_check builds the real ee.c against the emulated EEPROM in avr_shim.c instead.
+*/
+
+#include <string.h>
+#include "avr_shim.h"
+#include "../siggen/common.h"
+#include "../siggen/ee.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Private variables
+//////////////////////////////////////////////////////////////////////////
+
+static uint8_t ee_shim_payload[32];
+static bool ee_shim_payload_valid = false;
+
+//////////////////////////////////////////////////////////////////////////
+// Public functions
+//////////////////////////////////////////////////////////////////////////
+
+bool ee_write_byte(uint8_t address, uint8_t value)
+{
+	return true;
+}
+
+bool ee_write_block(uint8_t address, const void* data, uint8_t size)
+{
+	return true;
+}
+
+bool ee_busy()
+{
+	return false;
+}
+
+void ee_ring_initialize(ee_ring_t* ring, uint8_t base, uint8_t slot_size, uint8_t num_slots)
+{
+	ring->base = base;
+	ring->slot_size = slot_size;
+	ring->num_slots = num_slots;
+	ring->newest = 0;
+	ring->seq = 0;
+}
+
+void ee_ring_read(const ee_ring_t* ring, void* payload)
+{
+	if (ee_shim_payload_valid) {
+		memcpy(payload, ee_shim_payload, ring->slot_size - 1);
+	} else {
+		memset(payload, 0xFF, ring->slot_size - 1);			// Erased EEPROM
+	}
+}
+
+bool ee_ring_write(ee_ring_t* ring, const void* payload)
+{
+	memcpy(ee_shim_payload, payload, ring->slot_size - 1);
+	ee_shim_payload_valid = true;
+	return true;
+}
+
+// Erase the saved state
+void ee_shim_erase()
+{
+	ee_shim_payload_valid = false;
+}
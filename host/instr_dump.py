@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+Request and decode the ISR latency and run time histograms from the siggen firmware (Debug build).
+
+Sends 'H' on the serial port and decodes the binary frame described in siggen/instr.c, or decodes a frame
+previously saved to a file. With --clear, sends 'C' after the dump, so that the next dump starts from empty
+histograms.
+
+Usage:
+    instr_dump.py --port /dev/ttyUSB0 [--baud 38400] [--clear]
+    instr_dump.py --file dump.bin
+"""
+
+import argparse
+import struct
+import sys
+
+ISR_NAMES = ["pin (timer 0)", "chirp (timer 1)"]
+
+
+def bucket_label(bucket, num_buckets):
+    low = 0 if bucket == 0 else 1 << (bucket + 3)
+    if bucket == num_buckets - 1:
+        return ">= %d" % low
+    return "%d-%d" % (low, (1 << (bucket + 4)) - 1)
+
+
+def read_frame(read):
+    header = read(8)
+    if len(header) != 8 or header[0] != 0xA5 or header[1] != ord("H"):
+        raise ValueError("bad frame header: %r" % header)
+    num_isrs, num_buckets = header[2], header[3]
+    f_cpu = struct.unpack_from("<I", header, 4)[0]
+    per_isr = 2 * num_buckets + 4
+    body = read(num_isrs * per_isr + 1)
+    if len(body) != num_isrs * per_isr + 1:
+        raise ValueError("short frame")
+    if (sum(header) + sum(body[:-1])) & 0xFF != body[-1]:
+        raise ValueError("bad checksum")
+    isrs = []
+    for isr in range(num_isrs):
+        values = struct.unpack_from("<%dB2H" % (2 * num_buckets), body, isr * per_isr)
+        isrs.append({
+            "latency": values[:num_buckets],
+            "run_time": values[num_buckets:2 * num_buckets],
+            "max_latency": values[2 * num_buckets],
+            "max_run_time": values[2 * num_buckets + 1],
+        })
+    return f_cpu, num_buckets, isrs
+
+
+def print_report(f_cpu, num_buckets, isrs):
+    print("F_CPU %d Hz" % f_cpu)
+    for isr, hist in enumerate(isrs):
+        name = ISR_NAMES[isr] if isr < len(ISR_NAMES) else "isr %d" % isr
+        print("%s: max latency %d cycles (%.2f us), max run time %d cycles (%.2f us)" % (
+            name, hist["max_latency"], hist["max_latency"] * 1e6 / f_cpu,
+            hist["max_run_time"], hist["max_run_time"] * 1e6 / f_cpu))
+        print("  %-12s %10s %10s  (relative counts)" % ("cycles", "latency", "run time"))
+        for bucket in range(num_buckets):
+            print("  %-12s %10d %10d" % (bucket_label(bucket, num_buckets),
+                                         hist["latency"][bucket], hist["run_time"][bucket]))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--port", help="serial port connected to the USART")
+    source.add_argument("--file", help="file holding a saved dump frame")
+    parser.add_argument("--baud", type=int, default=38400)
+    parser.add_argument("--clear", action="store_true", help="clear the histograms after dumping them")
+    args = parser.parse_args()
+
+    if args.file:
+        with open(args.file, "rb") as f:
+            frame = read_frame(f.read)
+    else:
+        import serial
+        with serial.Serial(args.port, args.baud, timeout=2) as port:
+            port.reset_input_buffer()
+            port.write(b"H")
+            frame = read_frame(port.read)
+            if args.clear:
+                port.write(b"C")
+
+    print_report(*frame)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
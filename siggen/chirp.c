@@ -0,0 +1,231 @@
+/*
+* Linear frequency chirp generated by streaming precomputed tuning words to the DDS.
+*
+* The foreground producer (chirp_fill) computes the tuning word for each step of the sweep, splits it into
+* the two 14-bit frequency register halves with the register address bits already set, and puts them in a
+* RAM ring. The timer 1 compare match interrupt takes one entry per tick and sends it to the DDS, so the
+* retune rate is fixed by the timer and doesn't depend on how long the foreground takes per step.
+*
+* Entries alternate between the freq0 and freq1 register sets by ring slot parity, so the DDS keeps
+* producing the current frequency while the next one is loaded. If the ring is empty at a tick the ISR
+* leaves the output frequency unchanged and counts an underrun.
+*
+* While a chirp is running the ISR owns the USI, so nothing else may talk to the DDS or the LCD.
+*/
+
+#include <avr/io.h>
+#include "common.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "dds.h"
+#include "lcd.h"
+#include "chirp.h"
+#include "pin.h"
+#include "instr.h"
+
+#if CHIRP_ENABLE
+
+//////////////////////////////////////////////////////////////////////////
+// Private variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+#define CHIRP_RING_SIZE 16						// Number of ring slots. Must be a power of 2, and even so that slot parity selects the register set.
+#define CHIRP_RING_MASK (CHIRP_RING_SIZE - 1)
+#define CHIRP_PIN_ISR_CYCLES 100				// Upper bound on the timer 0 debounce ISR, entry and return included
+#define CHIRP_CPU_BUDGET_PERCENT 75				// Share of the remaining CPU time the ISR and the producer may use together
+#define CHIRP_TRIGGER_TOP 0xFFFF				// Compare value used to trigger the ISR once while measuring it
+
+// The 16-bit timer 1 registers are accessed through the shared TEMP register. In the Debug build the timer 0
+// ISR reads TCNT1 too (INSTR_ENTER and INSTR_EXIT in pin.c), so foreground accesses to them are made with
+// interrupts disabled; otherwise that ISR could land between the two byte accesses and tear the value.
+
+volatile uint16_t chirp_lsb_words[CHIRP_RING_SIZE];	// Freq LSB register writes, address bits included
+volatile uint16_t chirp_msb_words[CHIRP_RING_SIZE];	// Freq MSB register writes, address bits included
+volatile uint8_t chirp_head = 0;				// Next slot to fill. Written only by the producer.
+volatile uint8_t chirp_tail = 0;				// Next slot to send. Written only by the ISR.
+volatile uint16_t chirp_underrun_count = 0;		// Ticks where the ring was empty. Saturates at 65535.
+
+unsigned long chirp_word;						// Tuning word for the next slot to fill
+unsigned long chirp_start_word;					// Tuning word at the start of the sweep
+unsigned long chirp_stop_word;					// Tuning word at the end of the sweep
+unsigned long chirp_step_word;					// Tuning word increment per update
+
+// Interrupt service routine for timer 1 compare match A. Sends the next ring entry to the DDS.
+ISR(TIMER1_COMPA_vect)
+{
+	INSTR_ENTER();												// Timer 1 was cleared at the compare match, so it holds the latency
+	uint8_t tail = chirp_tail;
+	if (tail == chirp_head) {									// Ring empty?
+		if (chirp_underrun_count != 0xFFFF) {chirp_underrun_count++;}
+		INSTR_EXIT(INSTR_ISR_CHIRP, INSTR_ENTRY_TIME());
+		return;
+	}
+	uint16_t words[3];
+	words[0] = chirp_lsb_words[tail];							// Load the inactive register set
+	words[1] = chirp_msb_words[tail];
+	words[2] = dds_control_words[tail & 1];						// Switch the output to it
+	dds_send_words(words, 3);
+	chirp_tail = (tail + 1) & CHIRP_RING_MASK;					// Hand the slot back to the producer
+	INSTR_EXIT(INSTR_ISR_CHIRP, INSTR_ENTRY_TIME());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+// Measure the maximum number of DDS updates per second that can be sustained at the current SPI speed.
+// Each update costs one run of the ISR, entry and return included, plus one ring entry from chirp_fill().
+// Both are timed with timer 1 counting the system clock. The ISR is triggered once by a real compare match
+// and sends the active tuning word to the active register set, so the DDS output is not disturbed. The
+// timer 0 debounce ISR is subtracted from the available CPU time and the rest is derated to leave headroom
+// for the foreground. The shortest of several ISR runs is used, in case the debounce ISR interrupted one.
+// Enables interrupts while the ISR is measured. Must not be called while a chirp is running.
+unsigned long chirp_max_update_rate()
+{
+	uint8_t sreg = SREG;
+	uint8_t active_set = dds_devices[0].register_set ^ 1;
+	uint16_t fill_cycles;
+	uint16_t isr_cycles = 0xFFFF;
+	
+	instr_timer1_claim();
+	TCCR1A = 0;
+	TCCR1B = (1 << CS10);										// Normal mode, no prescaling
+	
+	// Fill the whole ring with the active tuning word, starting at a slot whose parity matches the active set
+	chirp_word = dds_devices[0].tuning_word;
+	chirp_start_word = chirp_word;
+	chirp_stop_word = 0x0FFFFFFF;
+	chirp_step_word = 0;
+	chirp_head = active_set;
+	chirp_tail = active_set;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		uint16_t start = TCNT1;
+		chirp_fill();
+		fill_cycles = TCNT1 - start;
+	}
+	fill_cycles = (fill_cycles + CHIRP_RING_SIZE - 2) / (CHIRP_RING_SIZE - 1);	// Per entry, rounded up
+	
+	for (uint8_t i = 0; i < 4; i++) {
+		cli();
+		chirp_tail = active_set;								// Only the first slot is pending
+		chirp_head = active_set + 1;
+		TCCR1B = 0;
+		OCR1A = CHIRP_TRIGGER_TOP;
+		TCNT1 = CHIRP_TRIGGER_TOP - 16;							// Match shortly after interrupts are enabled
+		TIFR = (1 << OCF1A);									// Clear any stale match
+		TIMSK |= (1 << OCIE1A);
+		TCCR1B = (1 << WGM12) | (1 << CS10);					// CTC, so the timer counts from zero at the match
+		sei();
+		while (chirp_tail == active_set) {}						// Wait for the ISR to send the slot
+		uint16_t cycles;
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			cycles = TCNT1;
+		}
+		TIMSK &= ~(1 << OCIE1A);
+		if (cycles < isr_cycles) {isr_cycles = cycles;}
+	}
+	SREG = sreg;
+	TCCR1B = 0;													// Stop the timer
+	instr_timer1_release();
+	
+	unsigned long available = F_CPU - F_CPU / PIN_TICK_CYCLES * CHIRP_PIN_ISR_CYCLES;
+	return available / 100 * CHIRP_CPU_BUDGET_PERCENT / (isr_cycles + fill_cycles);
+}
+
+// Start a linear chirp that sweeps up from start_freq to stop_freq in steps of step_freq, then repeats.
+// Frequencies are in Hz. The DDS is retuned update_rate times per second. Returns false without starting
+// if the parameters are invalid or update_rate is more than chirp_max_update_rate() says can be sustained.
+bool chirp_start(unsigned long start_freq, unsigned long stop_freq, unsigned long step_freq, unsigned long update_rate)
+{
+	if (stop_freq <= start_freq || step_freq == 0 || update_rate == 0) {return false;}
+	if (update_rate > chirp_max_update_rate()) {return false;}
+	unsigned long timer_ticks = F_CPU / update_rate;
+	if (timer_ticks > 0x10000) {return false;}					// Too slow for timer 1 without a prescaler
+	
+	chirp_start_word = dds_calc_tuning_word_integral(start_freq);
+	chirp_stop_word = dds_calc_tuning_word_integral(stop_freq);
+	chirp_step_word = dds_calc_tuning_word_integral(step_freq);
+	if (chirp_step_word == 0) {chirp_step_word = 1;}			// Step smaller than the DDS resolution
+	chirp_word = chirp_start_word;
+	
+	// Start at the slot whose parity matches the register set that isn't driving the output. The slot before
+	// it holds the current tuning word, so chirp_stop() finds the right one even if no tick has run yet.
+	chirp_head = dds_devices[0].register_set;
+	chirp_tail = dds_devices[0].register_set;
+	uint8_t previous = (dds_devices[0].register_set - 1) & CHIRP_RING_MASK;
+	chirp_lsb_words[previous] = (uint16_t)(dds_devices[0].tuning_word & 0x00003FFF);
+	chirp_msb_words[previous] = (uint16_t)(dds_devices[0].tuning_word >> 14);
+	chirp_underrun_count = 0;
+	chirp_fill();												// Prime the ring before the first tick
+	
+	instr_timer1_claim();
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TCCR1A = 0;
+		TCCR1B = (1 << WGM12);									// Timer in CTC mode with OCR1A as top
+		TCNT1 = 0;
+		OCR1A = timer_ticks - 1;
+		TCCR1B |= (1 << CS10);									// No prescaling. Counter starts counting.
+		TIMSK |= (1 << OCIE1A);									// Enable output compare match interrupt on timer 1
+	}
+	sei();
+	return true;
+}
+
+// Fill the ring with the next steps of the sweep. Call this repeatedly from the foreground while a chirp
+// is running; it returns as soon as the ring is full.
+void chirp_fill()
+{
+	uint8_t head = chirp_head;
+	uint8_t next = (head + 1) & CHIRP_RING_MASK;
+	while (next != chirp_tail) {								// Until the ring is full
+		uint32_t tuning_bits = chirp_word & 0x0FFFFFFF;
+		chirp_lsb_words[head] = dds_freq_addr_bits[head & 1] | (uint16_t)(tuning_bits & 0x00003FFF);
+		chirp_msb_words[head] = dds_freq_addr_bits[head & 1] | (uint16_t)(tuning_bits >> 14);
+		head = next;
+		chirp_head = head;										// Publish the slot to the ISR
+		next = (head + 1) & CHIRP_RING_MASK;
+		
+		chirp_word += chirp_step_word;
+		if (chirp_word > chirp_stop_word) {chirp_word = chirp_start_word;}
+	}
+}
+
+// Stop the chirp. The output stays at the last frequency sent.
+void chirp_stop()
+{
+	TIMSK &= ~(1 << OCIE1A);									// Disable output compare match interrupt on timer 1
+	TCCR1B = 0;													// Stop the timer
+	instr_timer1_release();
+	uint8_t last = (chirp_tail - 1) & CHIRP_RING_MASK;			// Slot now driving the output
+	dds_devices[0].tuning_word = ((unsigned long)(chirp_msb_words[last] & 0x3FFF) << 14) | (chirp_lsb_words[last] & 0x3FFF);
+	dds_devices[0].register_set = chirp_tail & 1;					// Next register set for normal frequency changes
+}
+
+// Number of timer ticks where the ring was empty since the chirp was started
+uint16_t chirp_underruns()
+{
+	uint16_t underruns;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		underruns = chirp_underrun_count;
+	}
+	return underruns;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Test functions
+//////////////////////////////////////////////////////////////////////////
+
+void chirp_test1()
+{
+	// Show the maximum sustainable update rate, then sweep 100 kHz to 1 MHz in 100 Hz steps at 10000 updates/s
+	lcd_show_integer(chirp_max_update_rate());
+	if (!chirp_start(100000, 1000000, 100, 10000)) {
+		lcd_show_ascii("ERR     ");
+		return;
+	}
+	while (1) {
+		chirp_fill();
+	}
+}
+
+#endif /* CHIRP_ENABLE */
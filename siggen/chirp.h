@@ -0,0 +1,25 @@
+/*
+* Linear frequency chirp generated by streaming precomputed tuning words to the DDS.
+*/
+
+#ifndef CHIRP_H_
+#define CHIRP_H_
+
+// Chirp mode is only built when the build defines CHIRP_ENABLE as 1. Otherwise its timer 1 vector would
+// link the ring and the sweep state, 84 of the 256 bytes of RAM, into every build.
+#ifndef CHIRP_ENABLE
+#define CHIRP_ENABLE 0
+#endif
+
+#if CHIRP_ENABLE
+
+unsigned long chirp_max_update_rate();
+bool chirp_start(unsigned long start_freq, unsigned long stop_freq, unsigned long step_freq, unsigned long update_rate);
+void chirp_fill();
+void chirp_stop();
+uint16_t chirp_underruns();
+void chirp_test1();
+
+#endif /* CHIRP_ENABLE */
+
+#endif /* CHIRP_H_ */
@@ -7,6 +7,6 @@
 
 #include <stdbool.h>
 
-#define F_CPU 16384000UL	// 16.384 MHz
+#define F_CPU 16384000UL	// 16.384 MHz. Timing that depends on it is derived in timing.h and pin.h.
 
 #endif /* COMMON_H_ */
\ No newline at end of file
@@ -2,13 +2,18 @@
 * Functions for handling the DDS chip.
 *
 * The timing of operations in this function must meet the minimum timing constraints of the
-* Analog Devices AD9834 DDS chip. This functions assumes a system clock of 16.384 MHz and that this
+* Analog Devices AD9834 DDS chip. The clock delays are derived from F_CPU in timing.h. This assumes that this
 * function has been compiled with optimization level -O1 or -Os). If the function is not compiled
 * with optimization (-O0) the function will still work, but will send bits to the DDS more slowly.
 */
 
 #include <avr/io.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
 #include "common.h"
+#include "timing.h"
+#include "dds.h"
+#include "ee.h"
 
 //////////////////////////////////////////////////////////////////////////
 // Private variables and functions
@@ -17,41 +22,95 @@
 // External assembly function for multiplying two 32-bit unsigned integers to get a 64-bit unsigned result
 extern unsigned long long mul_32x32(unsigned long multiplicand, unsigned long multiplier);
 
-// Send 16 bits to the DDS using the SPI protocol
-void dds_send_16_bits(uint16_t value)
+// Shift 16 bits out to the DDS using the SPI protocol. The DDS must already be selected. The DDS takes
+// each group of 16 bits as one word, so several words can be shifted while it stays selected.
+void dds_shift_16_bits(uint16_t value)
 {
 	uint8_t ms_byte = value >> 8;
 	uint8_t ls_byte = value;
 	
-	PORTB |= _BV(PORTB7);					// Set USCK initially high. DDS expects this before chip select goes low.
-	PORTB &= ~_BV(PORTB0);					// Port B pin 0 low, DDS chip selected.
-	
 	// Send the most-significant byte. Top bit goes first.
 	USIDR = ms_byte;						// Load byte to be sent. This sets the DO line to the value of the top bit.
 	for (uint8_t i=0; i<8; i++) {			// Clock 8 bits out of the USI shift-register
 		USICR |= _BV(USITC);				// Toggle the clock pin, falling edge. DDS samples DO line.
-		asm volatile("nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		::);
+		TIMING_DELAY_CYCLES(DDS_SCLK_LOW_PAD_CYCLES);
 		USICR |= _BV(USITC);				// Toggle the clock pin, rising edge
 		USICR |= _BV(USICLK);				// Strobe the USI shift-register and counter; this sets up the next data bit.
+		TIMING_DELAY_CYCLES(DDS_SCLK_HIGH_PAD_CYCLES);
 	}
 	// Send the least-significant byte. Top bit goes first.
 	USIDR = ls_byte;						// Load byte to be sent. This sets the DO line to the value of the top bit.
 	for (uint8_t i=0; i<8; i++) {			// Clock 8 bits out of of the USI shift-register
 		USICR |= _BV(USITC);				// Toggle the clock pin, falling edge. DDS samples DO line.
-		asm volatile("nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		::);
+		TIMING_DELAY_CYCLES(DDS_SCLK_LOW_PAD_CYCLES);
 		USICR |= _BV(USITC);				// Toggle the clock pin, rising edge
 		USICR |= _BV(USICLK);				// Strobe the USI shift-register and counter; this sets up the next data bit.
+		TIMING_DELAY_CYCLES(DDS_SCLK_HIGH_PAD_CYCLES);
 	}
-	
-	PORTB |= _BV(PORTB0);					// Port B pin 0 high; SPI chip deselected
+}
+
+// Chip select pin of each DDS device on port B, in device order: device 0, the main output, on pin 0 and
+// device 1, for example Q of an I/Q pair, on pin 3. A board with other pins or more devices defines
+// DDS_CS_MASKS in the build, with one port B bit for each device.
+#ifndef DDS_CS_MASKS
+#define DDS_CS_MASKS {_BV(PORTB0), _BV(PORTB3)}
+#endif
+const uint8_t dds_cs_masks[] PROGMEM = DDS_CS_MASKS;
+_Static_assert(sizeof(dds_cs_masks) >= DDS_NUM_DEVICES, "DDS_CS_MASKS needs a chip select pin for each DDS device");
+
+dds_device_t dds_devices[DDS_NUM_DEVICES];		// Chip selects are set up by dds_initialize()
+
+// Chip select pins of all the DDS devices
+static inline uint8_t dds_cs_all()
+{
+	uint8_t cs_mask = 0;
+	for (uint8_t i = 0; i < DDS_NUM_DEVICES; i++) {
+		cs_mask |= dds_devices[i].cs_mask;
+	}
+	return cs_mask;
+}
+
+// Select one or more DDS chips to start a burst of words. All the chips in cs_mask are selected on the
+// same instruction, so they all take the words that follow.
+static inline void dds_select(uint8_t cs_mask)
+{
+	PORTB |= _BV(PORTB7);					// Set USCK initially high. DDS expects this before chip select goes low.
+	PORTB &= ~cs_mask;						// Chip select pins low, DDS chips selected.
+}
+
+// Deselect the DDS chips to end a burst of words
+static inline void dds_deselect(uint8_t cs_mask)
+{
+	PORTB |= cs_mask;						// Chip select pins high; SPI chips deselected
+}
+
+// Send a number of words from RAM to the DDS chips in cs_mask in one chip select burst
+void dds_send_words_cs(uint8_t cs_mask, const uint16_t* words, uint8_t count)
+{
+	dds_select(cs_mask);
+	while (count--) {
+		dds_shift_16_bits(*words++);
+	}
+	dds_deselect(cs_mask);
+}
+
+// Send 16 bits to the main DDS using the SPI protocol
+void dds_send_16_bits(uint16_t value)
+{
+	dds_send_words_cs(dds_devices[0].cs_mask, &value, 1);
+}
+
+// Send a number of words from RAM to the main DDS in one chip select burst
+void dds_send_words(const uint16_t* words, uint8_t count)
+{
+	dds_send_words_cs(dds_devices[0].cs_mask, words, count);
+}
+
+// Send a number of words from RAM to all DDS chips at once in one chip select burst. Each word takes effect
+// on every chip on the same clock edge.
+void dds_broadcast_words(const uint16_t* words, uint8_t count)
+{
+	dds_send_words_cs(dds_cs_all(), words, count);
 }
 
 // DDS control word bit usage:
@@ -73,29 +132,102 @@ void dds_send_16_bits(uint16_t value)
 // DB0 = 0 : Reserved, must be 0
 
 // Alternate between using freq0/phase0 register set and freq1/phase1 register set so that the DDS chip continues producing output specified
-// by one register set while the other register set is being loaded for the next frequency/phase output.
-uint8_t dds_register_set = 0;								// Next freq/phase register set to use: 0 or 1, alternates with each freq change
+// by one register set while the other register set is being loaded for the next frequency/phase output. Each device keeps track of its own
+// next register set in dds_device_t.
 const uint16_t dds_control_reset_bit = 0x0100;				// Control register bit to put DDS into reset state
 const uint16_t dds_control_words[2] = {0x2000, 0x2C00};		// Control word for the two register sets
 const uint16_t dds_freq_addr_bits[2] = {0x4000, 0x8000};	// Register addr bits for frequency registers
 const uint16_t dds_phase_addr_bits[2] = {0xC000, 0xE000};	// Register addr bits for phase registers
 
-// Change the DDS frequency by giving it a new tuning word to add to the phase accumulator
-void dds_change_frequency(unsigned long tuning_word) {
+// Change the frequency of one DDS device by giving it a new tuning word to add to the phase accumulator
+void dds_device_change_frequency(dds_device_t* device, unsigned long tuning_word) {
 	uint32_t tuning_bits = (uint32_t)(tuning_word & 0x0FFFFFFF);			// Mask tuning value to lower 28 bits only
 	uint16_t tuning_bits_lower = (uint16_t)(tuning_bits & 0x00003FFF);			// Get least-significant 14 bits of tuning value
 	uint16_t tuning_bits_upper = (uint16_t)(tuning_bits >> 14);					// Get most-significant 14 bits of tuning value
+	uint8_t set = device->register_set;
 	
-//	dds_send_16_bits(dds_control_words[dds_register_set] | dds_control_reset_bit);	// Load control word that identifies register set to use
-	dds_send_16_bits(dds_freq_addr_bits[dds_register_set] | tuning_bits_lower);		// Set top two bits to register address and send freq LSBs to DDS
-	dds_send_16_bits(dds_freq_addr_bits[dds_register_set] | tuning_bits_upper);		// Set top two bits to register address and send freq MSBs to DDS
-	dds_send_16_bits(dds_control_words[dds_register_set]);							// Load control word that identifies register set to use
+	uint16_t words[3];
 	
-	dds_register_set = dds_register_set == 0 ? 1 : 0;								// Select the register set to use next time
+	words[0] = dds_freq_addr_bits[set] | tuning_bits_lower;					// Set top two bits to register address and send freq LSBs to DDS
+	words[1] = dds_freq_addr_bits[set] | tuning_bits_upper;					// Set top two bits to register address and send freq MSBs to DDS
+	words[2] = dds_control_words[set];										// Load control word that identifies register set to use
+	dds_send_words_cs(device->cs_mask, words, 3);							// All three in one chip select burst
+	
+	device->tuning_word = tuning_bits;
+	device->register_set = set == 0 ? 1 : 0;								// Select the register set to use next time
+}
+
+// Change the frequency of the main DDS
+void dds_change_frequency(unsigned long tuning_word) {
+	dds_device_change_frequency(&dds_devices[0], tuning_word);
+}
+
+// Output state saved in EEPROM so that the output can be restored at power-up without recomputation
+typedef struct {
+	unsigned long tuning_word;		// Tuning word driving the output
+	uint8_t register_set;			// Register set holding the tuning word
+	uint32_t display_value;			// Value shown on the LCD for this output
+	uint8_t check;					// Check byte, see dds_saved_state_check()
+} dds_saved_state_t;
+
+// The saved state changes whenever the output is saved, so it is wear-leveled over a ring of slots
+#define DDS_SAVED_STATE_SLOTS 8
+uint8_t dds_saved_state_slots[DDS_SAVED_STATE_SLOTS][1 + sizeof(dds_saved_state_t)] EEMEM;
+ee_ring_t dds_saved_state_ring;
+uint32_t dds_restored_display = 0;		// Display value restored at startup, 0 if nothing was restored
+
+// Compute the check byte of a record saved in EEPROM: the sum of its bytes, seeded so that erased EEPROM
+// (all 0xFF) does not pass
+uint8_t dds_check_byte(const void* data, uint8_t length)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	uint8_t sum = 0xA5;
+	for (uint8_t i = 0; i < length; i++) {
+		sum += bytes[i];
+	}
+	return sum;
 }
 
-// Multiply the desired frequency by this ratio to get the tuning word. Equal to 2^28 / 75000000.
-const unsigned long dds_tuning_freq_ratio = 0xE5109EC2;		// tuning/freq ratio of 3.57913941333333 in Q2.30 fixed point format
+// Compute the check byte of a saved state, over every byte before the check byte
+uint8_t dds_saved_state_check(const dds_saved_state_t* state)
+{
+	return dds_check_byte(state, sizeof(dds_saved_state_t) - 1);
+}
+
+// Multiply the desired frequency by this ratio to get the tuning word. Nominally equal to 2^28 / 75000000.
+// Replaced at startup by the calibrated ratio from EEPROM, if there is one.
+#define DDS_NOMINAL_TUNING_FREQ_RATIO 0xE5109EC2UL			// tuning/freq ratio of 3.57913941333333 in Q2.30 fixed point format
+unsigned long dds_tuning_freq_ratio = DDS_NOMINAL_TUNING_FREQ_RATIO;
+
+// Calibrated ratio saved in EEPROM
+typedef struct {
+	unsigned long tuning_freq_ratio;	// Q2.30 fixed point
+	uint8_t check;						// Check byte over all four bytes of the ratio, see dds_check_byte()
+} dds_calibration_t;
+
+dds_calibration_t dds_calibration EEMEM;
+
+// Compute (numerator * 2^30) / denominator, rounded, by shift-and-subtract long division. The numerator must
+// be less than 2^28 and the quotient must fit in 32 bits. Used once per calibration, so it is small rather
+// than fast.
+unsigned long dds_divide_q30(unsigned long numerator, unsigned long denominator)
+{
+	unsigned long quotient = 0;
+	unsigned long remainder = 0;
+	numerator <<= 4;										// Align the 28 numerator bits to the top
+	for (uint8_t i = 0; i < 28 + 30; i++) {
+		bool carry = remainder & 0x80000000UL;				// Remainder shifted into a 33rd bit
+		remainder = (remainder << 1) | (numerator >> 31);	// Bring down the next dividend bit; zeros after the numerator
+		numerator <<= 1;
+		quotient <<= 1;
+		if (carry || remainder >= denominator) {
+			remainder -= denominator;
+			quotient |= 1;
+		}
+	}
+	if (remainder >= denominator - remainder) {quotient++;}	// Round to nearest
+	return quotient;
+}
 
 // Calculate a DDS tuning word given a desired output frequency in unsigned Q25.7 fixed point format
 unsigned long dds_calc_tuning_word_fractional(unsigned long output_freq) {
@@ -124,19 +256,73 @@ unsigned long dds_calc_tuning_word_integral(unsigned long output_freq) {
 //////////////////////////////////////////////////////////////////////////
 
 // Initialize the MCU for communicating with the DDS and then initialize the DDS. Called once at startup.
+// If a valid output state was saved in EEPROM, its tuning word is loaded while the DDS is held in reset and
+// the reset is released straight into it, so the output comes up at the saved frequency. Otherwise the DDS
+// is left in reset with all registers zeroed until the first frequency change. With more than one device,
+// all of them get the same words, so they start out in step on the same register set.
 void dds_initialize()
 {
-	DDRB |= _BV(DDB0);													// Port B pin 0 is an output for DDS Slave Select
-	PORTB |= _BV(PORTB0);												// Port B pin 0 high; DDS chip SPI disabled
+	for (uint8_t i = 0; i < DDS_NUM_DEVICES; i++) {
+		dds_devices[i].cs_mask = pgm_read_byte(&dds_cs_masks[i]);
+	}
+	DDRB |= dds_cs_all();												// Chip select pins are outputs
+	PORTB |= dds_cs_all();												// Chip select pins high; DDS chips SPI disabled
+	
+	dds_calibration_t calibration;
+	eeprom_read_block(&calibration, &dds_calibration, sizeof(calibration));
+	if (calibration.check == dds_check_byte(&calibration.tuning_freq_ratio, sizeof(calibration.tuning_freq_ratio))) {
+		dds_tuning_freq_ratio = calibration.tuning_freq_ratio;
+	}
+	
+	dds_saved_state_t saved;
+	ee_ring_initialize(&dds_saved_state_ring, EE_ADDR(dds_saved_state_slots), sizeof(dds_saved_state_slots[0]), DDS_SAVED_STATE_SLOTS);
+	ee_ring_read(&dds_saved_state_ring, &saved);
+	bool restore = saved.check == dds_saved_state_check(&saved);
+	uint8_t set = 0;
+	uint32_t tuning_bits = 0;
+	if (restore) {
+		set = saved.register_set & 1;
+		tuning_bits = saved.tuning_word & 0x0FFFFFFF;
+		dds_restored_display = saved.display_value;
+	}
 	
-	dds_send_16_bits(dds_control_words[0] | dds_control_reset_bit);		// Load control word that puts DDS in reset state
-	dds_send_16_bits(dds_freq_addr_bits[0] | 0x0000);					// Zero the freq0 LSB
-	dds_send_16_bits(dds_freq_addr_bits[0] | 0x0000);					// Zero the freq0 MSB
-	dds_send_16_bits(dds_phase_addr_bits[0] | 0x0000);					// Zero the phase0 register
-	dds_send_16_bits(dds_freq_addr_bits[1] | 0x0000);					// Zero the freq1 LSB
-	dds_send_16_bits(dds_freq_addr_bits[1] | 0x0000);					// Zero the freq1 MSB
-	dds_send_16_bits(dds_phase_addr_bits[1] | 0x0000);					// Zero the phase1 register
-	dds_register_set = 0;												// Set which frequency and phase registers to use next
+	// Reset is released as soon as the active register set is loaded, and the inactive set is zeroed after
+	// that, since it doesn't affect the output
+	uint16_t words[8];
+	uint8_t count = 0;
+	words[count++] = dds_control_words[set] | dds_control_reset_bit;	// Load control word that puts DDS in reset state
+	words[count++] = dds_freq_addr_bits[set] | (uint16_t)(tuning_bits & 0x00003FFF);	// Load the restored freq LSB, or zero
+	words[count++] = dds_freq_addr_bits[set] | (uint16_t)(tuning_bits >> 14);	// Load the restored freq MSB, or zero
+	words[count++] = dds_phase_addr_bits[set] | 0x0000;					// Zero the phase register
+	if (restore) {
+		words[count++] = dds_control_words[set];						// Release reset; output starts at the restored frequency
+	}
+	words[count++] = dds_freq_addr_bits[set ^ 1] | 0x0000;				// Zero the other freq LSB
+	words[count++] = dds_freq_addr_bits[set ^ 1] | 0x0000;				// Zero the other freq MSB
+	words[count++] = dds_phase_addr_bits[set ^ 1] | 0x0000;				// Zero the other phase register
+	dds_broadcast_words(words, count);									// All in one chip select burst, to every device
+	for (uint8_t i = 0; i < DDS_NUM_DEVICES; i++) {
+		dds_devices[i].tuning_word = tuning_bits;
+		dds_devices[i].register_set = set ^ 1;							// Set which frequency and phase registers to use next
+	}
+}
+
+// Display value that was saved along with the output state restored by dds_initialize(), or 0 if none was restored
+uint32_t dds_restored_display_value()
+{
+	return dds_restored_display;
+}
+
+// Save the current output state and the value displayed for it, to be restored at the next power-up.
+// The write is queued and done in the background. Returns false if the EEPROM write queue was full.
+bool dds_save_state(uint32_t display_value)
+{
+	dds_saved_state_t state;
+	state.tuning_word = dds_devices[0].tuning_word;
+	state.register_set = dds_devices[0].register_set ^ 1;				// The set most recently loaded is driving the output
+	state.display_value = display_value;
+	state.check = dds_saved_state_check(&state);
+	return ee_ring_write(&dds_saved_state_ring, &state);
 }
 
 // Set the DDS output to a frequency specified in unsigned Q25.7 fixed point format
@@ -151,6 +337,139 @@ void dds_set_frequency_integral(unsigned long frequency) {
 	dds_change_frequency(tuning_word);
 }
 
+// Multiple devices are updated together in two steps. First dds_preload() loads the next frequency and
+// phase into the inactive register set of each device, one device at a time, while the outputs carry on
+// unchanged. Then dds_commit() or dds_restart_coherent() broadcasts one control word sequence to all the
+// devices at once, so they all switch on the same clock edge. This only works while all devices are on the
+// same register set, which dds_initialize() sets up. A frequency change on one device alone, such as
+// dds_set_frequency_integral() on the main output, puts that device out of step; the functions below then
+// refuse and return false. Changing the frequency of the device once more, for example to its current tuning
+// word with dds_device_change_frequency(), brings it back into step.
+
+// True if every device is on the same register set as device 0
+static bool dds_devices_in_step()
+{
+	for (uint8_t i = 1; i < DDS_NUM_DEVICES; i++) {
+		if (dds_devices[i].register_set != dds_devices[0].register_set) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Load the next tuning word and phase (12 bits, 4096 = 360 degrees) into the inactive register set of a
+// device. Returns false, and sends nothing, if the devices are out of step, including when the device itself
+// is the one that was retuned alone.
+bool dds_preload(uint8_t device_index, unsigned long tuning_word, uint16_t phase)
+{
+	dds_device_t* device = &dds_devices[device_index];
+	if (!dds_devices_in_step()) {
+		return false;
+	}
+	uint32_t tuning_bits = tuning_word & 0x0FFFFFFF;
+	uint8_t set = device->register_set;
+	uint16_t words[3];
+	words[0] = dds_freq_addr_bits[set] | (uint16_t)(tuning_bits & 0x00003FFF);
+	words[1] = dds_freq_addr_bits[set] | (uint16_t)(tuning_bits >> 14);
+	words[2] = dds_phase_addr_bits[set] | (phase & 0x0FFF);
+	dds_send_words_cs(device->cs_mask, words, 3);
+	device->preloaded_word = tuning_bits;
+	return true;
+}
+
+// Make the devices' preloaded register sets current
+void dds_commit_preloaded()
+{
+	for (uint8_t i = 0; i < DDS_NUM_DEVICES; i++) {
+		dds_devices[i].tuning_word = dds_devices[i].preloaded_word;
+		dds_devices[i].register_set ^= 1;
+	}
+}
+
+// Switch every device to its preloaded frequency and phase on the same clock edge. Each device's phase
+// accumulator carries on from where it was, so the phase relationship between devices is kept only if
+// they had the same frequency before. Returns false, and sends nothing, if the devices are out of step.
+bool dds_commit()
+{
+	if (!dds_devices_in_step()) {
+		return false;
+	}
+	uint16_t control_word = dds_control_words[dds_devices[0].register_set];
+	dds_broadcast_words(&control_word, 1);
+	dds_commit_preloaded();
+	return true;
+}
+
+// Switch every device to its preloaded frequency and phase, and restart all phase accumulators from zero on
+// the same clock edge. The outputs are then phase coherent, offset only by their phase registers. Returns
+// false, and sends nothing, if the devices are out of step.
+bool dds_restart_coherent()
+{
+	if (!dds_devices_in_step()) {
+		return false;
+	}
+	uint16_t words[2];
+	words[0] = dds_control_words[dds_devices[0].register_set] | dds_control_reset_bit;	// Hold all in reset
+	words[1] = dds_control_words[dds_devices[0].register_set];							// Release all together
+	dds_broadcast_words(words, 2);
+	dds_commit_preloaded();
+	return true;
+}
+
+// Replay a command script from program memory. A script is a list of chip select groups, each one a word
+// count followed by that many DDS words, and ends with a count of 0. The words of a group are sent in one
+// chip select burst, back to back at the full SPI rate.
+void dds_run_script(const uint16_t* script)
+{
+	uint16_t count;
+	while ((count = pgm_read_word(script++)) != 0) {
+		dds_select(dds_devices[0].cs_mask);
+		do {
+			dds_shift_16_bits(pgm_read_word(script++));
+		} while (--count);
+		dds_deselect(dds_devices[0].cs_mask);
+	}
+}
+
+// Start calibration of the reference clock: put out the calibration tuning word, nominally 1 MHz. Measure
+// the output frequency and pass it to dds_calibrate().
+void dds_calibration_start()
+{
+	dds_change_frequency(DDS_CALIBRATION_TUNING_WORD);
+}
+
+// Finish calibration given the measured output frequency in Hz for DDS_CALIBRATION_TUNING_WORD. Computes the
+// corrected tuning/freq ratio, uses it from now on and queues it to be saved in EEPROM. Returns false, and
+// changes nothing, if the measurement is more than 1% away from nominal or the EEPROM write queue is full.
+bool dds_calibrate(unsigned long measured_freq)
+{
+	if (measured_freq < DDS_CALIBRATION_FREQ - DDS_CALIBRATION_FREQ / 100 ||
+		measured_freq > DDS_CALIBRATION_FREQ + DDS_CALIBRATION_FREQ / 100) {
+		return false;
+	}
+	dds_calibration_t calibration;
+	calibration.tuning_freq_ratio = dds_divide_q30(DDS_CALIBRATION_TUNING_WORD, measured_freq);
+	calibration.check = dds_check_byte(&calibration.tuning_freq_ratio, sizeof(calibration.tuning_freq_ratio));
+	if (!ee_write_block(EE_ADDR(&dds_calibration), &calibration, sizeof(calibration))) {
+		return false;
+	}
+	dds_tuning_freq_ratio = calibration.tuning_freq_ratio;
+	return true;
+}
+
+// Go back to the nominal ratio by saving it as the calibration. Returns false if the EEPROM write queue is full.
+bool dds_calibration_clear()
+{
+	dds_calibration_t calibration;
+	calibration.tuning_freq_ratio = DDS_NOMINAL_TUNING_FREQ_RATIO;
+	calibration.check = dds_check_byte(&calibration.tuning_freq_ratio, sizeof(calibration.tuning_freq_ratio));
+	if (!ee_write_block(EE_ADDR(&dds_calibration), &calibration, sizeof(calibration))) {
+		return false;
+	}
+	dds_tuning_freq_ratio = DDS_NOMINAL_TUNING_FREQ_RATIO;
+	return true;
+}
+
 //////////////////////////////////////////////////////////////////////////
 // Test functions
 //////////////////////////////////////////////////////////////////////////
@@ -177,35 +496,59 @@ void dds_test2() {
 	//tuning_word = dds_calc_tuning_word_fractional(0xAE9D85D9);	// desired freq = 22887179.6953125, freq_word should be 81916407
 }
 
+// 800 kHz , measure at Rf out
+const uint16_t dds_script_test3[] PROGMEM = {
+	4, 0x2100, 0x70D0, 0x40AE, 0x2000,
+	0
+};
+
+// 5 kHz, measure at audio out
+const uint16_t dds_script_test4[] PROGMEM = {
+	4, 0x2100, 0x45E8, 0x4001, 0x2000,
+	0
+};
+
+const uint16_t dds_script_test5[] PROGMEM = {
+	4, 0x2100, 0x45E8, 0x4002, 0x2000,
+	0
+};
+
+// .279 Hz, measure at audio out. Each word in its own chip select group.
+const uint16_t dds_script_test6[] PROGMEM = {
+	1, 0x2100,
+	1, 0x4001,
+	1, 0x4000,
+	1, 0x2000,
+	0
+};
+
 void dds_test3()
 {
-	// 800 kHz , measure at Rf out
-	dds_send_16_bits(0x2100);
-	dds_send_16_bits(0x70D0);
-	dds_send_16_bits(0x40AE);
-	dds_send_16_bits(0x2000);
+	dds_run_script(dds_script_test3);
 }
 
 void dds_test4()
 {
-	// 5 kHz, measure at audio out
-	dds_send_16_bits(0x2100);
-	dds_send_16_bits(0x45E8);
-	dds_send_16_bits(0x4001);
-	dds_send_16_bits(0x2000);
+	dds_run_script(dds_script_test4);
 }
 
 void dds_test5()
 {
-	dds_send_16_bits(0x2100);
-	dds_send_16_bits(0x45E8);
-	dds_send_16_bits(0x4002);
-	dds_send_16_bits(0x2000);
-	
-	// .279 Hz, measure at audio out
-	//dds_send_16_bits(0x2100);
-	//dds_send_16_bits(0x4001);
-	//dds_send_16_bits(0x4000);
-	//dds_send_16_bits(0x2000);
+	dds_run_script(dds_script_test5);
+}
+
+void dds_test6()
+{
+	dds_run_script(dds_script_test6);
 }
 
+#if DDS_NUM_DEVICES > 1
+void dds_test7()
+{
+	// 1 MHz I/Q pair: device 1 leads device 0 by 90 degrees, since the phase register adds to the phase
+	unsigned long tuning_word = dds_calc_tuning_word_integral(1000000);
+	dds_preload(0, tuning_word, 0);
+	dds_preload(1, tuning_word, 1024);
+	dds_restart_coherent();
+}
+#endif
@@ -5,7 +5,45 @@
 #ifndef DDS_H_
 #define DDS_H_
 
+// Reference clock calibration: the tuning word put out by dds_calibration_start() and its nominal frequency in Hz
+#define DDS_CALIBRATION_TUNING_WORD 3579139UL
+#define DDS_CALIBRATION_FREQ 1000000UL
+
+// Number of DDS chips on the USI bus. Device 0 is the main output, used by the single-device functions. Boards
+// with more than one define it in the build, along with DDS_CS_MASKS if the chip selects are not the ones in dds.c.
+#ifndef DDS_NUM_DEVICES
+#define DDS_NUM_DEVICES 1
+#endif
+
+// State of one DDS chip
+typedef struct {
+	uint8_t cs_mask;				// Chip select pin on port B
+	uint8_t register_set;			// Next freq/phase register set to use: 0 or 1, alternates with each freq change
+	unsigned long tuning_word;		// Tuning word currently driving the output
+	unsigned long preloaded_word;	// Tuning word loaded by dds_preload(), not yet committed
+} dds_device_t;
+
+extern dds_device_t dds_devices[DDS_NUM_DEVICES];
+
+// Register set tables and raw transfer, for modes that stream words to the DDS themselves
+extern const uint16_t dds_control_words[2];
+extern const uint16_t dds_freq_addr_bits[2];
+void dds_send_16_bits(uint16_t value);
+void dds_send_words(const uint16_t* words, uint8_t count);
+void dds_broadcast_words(const uint16_t* words, uint8_t count);
+void dds_run_script(const uint16_t* script);
+
 void dds_initialize();
+uint32_t dds_restored_display_value();
+bool dds_save_state(uint32_t display_value);
+void dds_calibration_start();
+bool dds_calibrate(unsigned long measured_freq);
+bool dds_calibration_clear();
+unsigned long dds_calc_tuning_word_integral(unsigned long output_freq);
+void dds_device_change_frequency(dds_device_t* device, unsigned long tuning_word);
+bool dds_preload(uint8_t device_index, unsigned long tuning_word, uint16_t phase);
+bool dds_commit();
+bool dds_restart_coherent();
 void dds_set_frequency_integral(unsigned long frequency);
 void dds_set_frequency_fractional(unsigned long frequency);
 void dds_test1();
@@ -13,5 +51,9 @@ void dds_test2();
 void dds_test3();
 void dds_test4();
 void dds_test5();
+void dds_test6();
+#if DDS_NUM_DEVICES > 1
+void dds_test7();
+#endif
 
 #endif /* DDS_H_ */
\ No newline at end of file
@@ -0,0 +1,187 @@
+/*
+* Asynchronous EEPROM writes, drained by the EEPROM ready interrupt.
+*
+* Each EEPROM byte write takes about 3.4 ms. Instead of waiting for it, the foreground puts the address and
+* value in a RAM queue and returns. The EEPROM ready interrupt takes the oldest entry whenever the EEPROM is
+* idle and starts its write, skipping bytes that already hold the value. A write to an address that is still
+* in the queue replaces the queued value rather than taking another entry, so rapidly changing state costs
+* one EEPROM write per byte however often it changes.
+*
+* EEPROM must not be read with the avr-libc functions while writes are queued, since the ISR uses the
+* EEPROM address and data registers. Reads are done at startup, before anything is queued.
+*/
+
+#include <avr/io.h>
+#include "common.h"
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <util/atomic.h>
+#include "ee.h"
+
+//////////////////////////////////////////////////////////////////////////
+// Private variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+#define EE_QUEUE_SIZE 12				// Largest block that can be queued at once
+
+volatile uint8_t ee_queue_address[EE_QUEUE_SIZE];
+volatile uint8_t ee_queue_value[EE_QUEUE_SIZE];
+volatile uint8_t ee_queue_tail = 0;		// Oldest entry. Advanced by the ISR.
+volatile uint8_t ee_queue_count = 0;	// Number of queued entries
+
+// Find the queued write to an address. Interrupts must be disabled. Returns its index in the queue, or
+// EE_QUEUE_SIZE if there is none.
+static uint8_t ee_queue_find(uint8_t address)
+{
+	uint8_t index = ee_queue_tail;
+	for (uint8_t i = 0; i < ee_queue_count; i++) {
+		if (ee_queue_address[index] == address) {
+			return index;
+		}
+		if (++index == EE_QUEUE_SIZE) {index = 0;}
+	}
+	return EE_QUEUE_SIZE;
+}
+
+// Queue one byte, or update the queued value if the address is already queued. Interrupts must be disabled.
+// Returns false if the queue is full.
+static bool ee_queue_byte(uint8_t address, uint8_t value)
+{
+	uint8_t index = ee_queue_find(address);
+	if (index != EE_QUEUE_SIZE) {
+		ee_queue_value[index] = value;							// Coalesce with the queued write
+		return true;
+	}
+	if (ee_queue_count == EE_QUEUE_SIZE) {
+		return false;
+	}
+	index = ee_queue_tail + ee_queue_count;
+	if (index >= EE_QUEUE_SIZE) {index -= EE_QUEUE_SIZE;}
+	ee_queue_address[index] = address;
+	ee_queue_value[index] = value;
+	ee_queue_count++;
+	return true;
+}
+
+// Interrupt service routine for the EEPROM ready interrupt. Starts the next queued write that changes a byte.
+ISR(EEPROM_READY_vect)
+{
+	while (ee_queue_count) {
+		uint8_t tail = ee_queue_tail;
+		uint8_t address = ee_queue_address[tail];
+		uint8_t value = ee_queue_value[tail];
+		ee_queue_tail = tail + 1 == EE_QUEUE_SIZE ? 0 : tail + 1;
+		ee_queue_count--;
+		
+		EEAR = address;
+		EECR |= _BV(EERE);										// Read the current value
+		if (EEDR == value) {
+			continue;											// Already there; no need to wear the cell
+		}
+		EEDR = value;
+		EECR = _BV(EERIE);										// Atomic erase and write mode, keep the interrupt enabled
+		EECR |= _BV(EEMPE);										// EEPE must be set within four cycles of EEMPE
+		EECR |= _BV(EEPE);										// Start the write; the interrupt fires again when it is done
+		return;
+	}
+	EECR &= ~_BV(EERIE);										// Nothing left to write
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+// Queue a write of one byte. Returns false if the queue is full.
+bool ee_write_byte(uint8_t address, uint8_t value)
+{
+	bool queued;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		queued = ee_queue_byte(address, value);
+		EECR |= _BV(EERIE);										// Fires as soon as the EEPROM is idle
+	}
+	return queued;
+}
+
+// Queue a write of a block of bytes. The block is queued completely or not at all; returns false if there
+// isn't room for it.
+bool ee_write_block(uint8_t address, const void* data, uint8_t size)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	bool queued = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		if (size <= EE_QUEUE_SIZE - ee_queue_count) {
+			for (uint8_t i = 0; i < size; i++) {
+				ee_queue_byte(address + i, bytes[i]);
+			}
+			queued = true;
+			EECR |= _BV(EERIE);
+		}
+	}
+	return queued;
+}
+
+// True while queued writes remain or a write is in progress
+bool ee_busy()
+{
+	return ee_queue_count || (EECR & _BV(EEPE));
+}
+
+// Find the newest slot of a wear-leveled ring. Slots are written in order with sequence numbers counting up,
+// so the newest slot is the first one whose successor does not have the next sequence number. Erased EEPROM
+// looks like a ring whose newest slot is slot 0. Reads the EEPROM, so call it at startup.
+void ee_ring_initialize(ee_ring_t* ring, uint8_t base, uint8_t slot_size, uint8_t num_slots)
+{
+	ring->base = base;
+	ring->slot_size = slot_size;
+	ring->num_slots = num_slots;
+	
+	uint8_t seq = eeprom_read_byte((const uint8_t*)(uint16_t)base);
+	uint8_t slot = 0;
+	while (slot < num_slots - 1) {
+		uint8_t next_seq = eeprom_read_byte((const uint8_t*)(uint16_t)(base + (slot + 1) * slot_size));
+		if (next_seq != (uint8_t)(seq + 1)) {
+			break;
+		}
+		seq = next_seq;
+		slot++;
+	}
+	ring->newest = slot;
+	ring->seq = seq;
+}
+
+// Read the payload of the newest slot. The caller checks that the payload is valid. Call it at startup.
+void ee_ring_read(const ee_ring_t* ring, void* payload)
+{
+	uint8_t address = ring->base + ring->newest * ring->slot_size + 1;
+	eeprom_read_block(payload, (const void*)(uint16_t)address, ring->slot_size - 1);
+}
+
+// Queue a write of a new payload to the next slot, payload first and sequence byte last. If the newest slot
+// is still queued in full from the last call, none of it has been written yet, so it is updated in the queue
+// instead and repeated writes coalesce. Once the EEPROM has started on a slot, the next write always goes to
+// the slot after it, so the last committed slot stays intact. Returns false if there isn't room in the queue.
+bool ee_ring_write(ee_ring_t* ring, const void* payload)
+{
+	const uint8_t* bytes = (const uint8_t*)payload;
+	bool queued = false;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		uint8_t address = ring->base + ring->newest * ring->slot_size;
+		// The payload bytes and then the sequence byte are queued in order, so if the first payload byte is
+		// still queued, so is the rest of the slot
+		bool pending = ee_queue_find(address + 1) != EE_QUEUE_SIZE;
+		if (pending || ring->slot_size <= EE_QUEUE_SIZE - ee_queue_count) {
+			if (!pending) {
+				ring->newest = ring->newest + 1 == ring->num_slots ? 0 : ring->newest + 1;
+				ring->seq++;
+				address = ring->base + ring->newest * ring->slot_size;
+			}
+			for (uint8_t i = 1; i < ring->slot_size; i++) {
+				ee_queue_byte(address + i, *bytes++);
+			}
+			ee_queue_byte(address, ring->seq);
+			queued = true;
+			EECR |= _BV(EERIE);
+		}
+	}
+	return queued;
+}
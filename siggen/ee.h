@@ -0,0 +1,27 @@
+/*
+* Asynchronous EEPROM writes, drained by the EEPROM ready interrupt.
+*/
+
+#ifndef EE_H_
+#define EE_H_
+
+// Address of an EEMEM variable as an EEPROM address. The ATtiny4313 has 256 bytes of EEPROM.
+#define EE_ADDR(p) ((uint8_t)(uint16_t)(p))
+
+// Wear-leveled state: a payload written round-robin to a ring of slots, each a sequence byte and the payload
+typedef struct {
+	uint8_t base;					// EEPROM address of slot 0
+	uint8_t slot_size;				// Sequence byte plus payload size
+	uint8_t num_slots;
+	uint8_t newest;					// Slot holding the newest payload
+	uint8_t seq;					// Sequence number of the newest slot
+} ee_ring_t;
+
+bool ee_write_byte(uint8_t address, uint8_t value);
+bool ee_write_block(uint8_t address, const void* data, uint8_t size);
+bool ee_busy();
+void ee_ring_initialize(ee_ring_t* ring, uint8_t base, uint8_t slot_size, uint8_t num_slots);
+void ee_ring_read(const ee_ring_t* ring, void* payload);
+bool ee_ring_write(ee_ring_t* ring, const void* payload);
+
+#endif /* EE_H_ */
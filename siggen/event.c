@@ -0,0 +1,36 @@
+/*
+* Queue of input events passed from interrupt service routines to the main loop.
+*
+* The queue is a single-producer, single-consumer ring buffer. Events are put by interrupt service routines
+* and taken by the main loop. Interrupts don't nest on the AVR, so all the ISRs together act as a single
+* producer. The producer only writes the head index and the consumer only writes the tail index, and both
+* indexes are single bytes, so neither side ever needs to disable interrupts.
+*/
+
+#include <avr/io.h>
+#include "common.h"
+#include "event.h"
+
+volatile event_t event_queue[EVENT_QUEUE_SIZE];
+volatile uint8_t event_head = 0;				// Next slot to put into. Written only by the producer.
+volatile uint8_t event_tail = 0;				// Next slot to take from. Written only by the consumer.
+volatile uint8_t event_overflow_count = 0;		// Events dropped because the queue was full. Saturates at 255.
+
+// Take the oldest event from the queue. Called from the main loop only. Returns false if the queue was empty.
+bool event_get(event_t* event)
+{
+	uint8_t tail = event_tail;
+	if (tail == event_head) {								// Queue empty?
+		return false;
+	}
+	event->type = event_queue[tail].type;					// Copy the slot out first...
+	event->data = event_queue[tail].data;
+	event_tail = (tail + 1) & EVENT_QUEUE_MASK;				// ...then hand it back to the producer
+	return true;
+}
+
+// Number of events dropped because the queue was full
+uint8_t event_overflows()
+{
+	return event_overflow_count;
+}
@@ -0,0 +1,45 @@
+/*
+* Queue of input events passed from interrupt service routines to the main loop.
+*/
+
+#ifndef EVENT_H_
+#define EVENT_H_
+
+// Event types
+#define EVENT_PIN_PRESSED 1			// A port D input went active. Data is the pin mask.
+#define EVENT_PIN_RELEASED 2		// A port D input went inactive. Data is the pin mask.
+
+typedef struct {
+	uint8_t type;					// One of the EVENT_ types
+	uint8_t data;					// Type-specific data
+} event_t;
+
+#define EVENT_QUEUE_SIZE 8						// Number of slots, must be a power of 2. One slot is always kept empty.
+#define EVENT_QUEUE_MASK (EVENT_QUEUE_SIZE - 1)
+
+extern volatile event_t event_queue[EVENT_QUEUE_SIZE];
+extern volatile uint8_t event_head;
+extern volatile uint8_t event_tail;
+extern volatile uint8_t event_overflow_count;
+
+// Put an event in the queue. Called from interrupt service routines only. Returns false if the queue
+// was full and the event was dropped. Inline so that an ISR putting events makes no calls, and avr-gcc
+// doesn't have to save every call-clobbered register on each entry.
+static inline bool event_put(uint8_t type, uint8_t data)
+{
+	uint8_t head = event_head;
+	uint8_t next = (head + 1) & EVENT_QUEUE_MASK;
+	if (next == event_tail) {								// Queue full?
+		if (event_overflow_count != 0xFF) {event_overflow_count++;}
+		return false;
+	}
+	event_queue[head].type = type;							// Fill in the slot first...
+	event_queue[head].data = data;
+	event_head = next;										// ...then publish it to the consumer
+	return true;
+}
+
+bool event_get(event_t* event);
+uint8_t event_overflows();
+
+#endif /* EVENT_H_ */
@@ -0,0 +1,156 @@
+/*
+* Instrumentation of interrupt service routines: entry latency and run time histograms, dumped over the USART.
+*
+* Timer 1 runs free at the system clock and is the time base. Each instrumented ISR reads it on entry and
+* exit; the difference is the run time. Entry latency is the time from the interrupt event to the first
+* read, which includes the ISR prologue:
+*
+* - Timer 0 compare match (pin.c): timer 0 and timer 1 are started together from a prescaler reset, so the
+*   compare matches happen when timer 1 is at whole multiples of the timer 0 period. The time of the next
+*   match is kept and advanced by the period on each tick, so any period works.
+* - Timer 1 compare match (chirp.c): chirp mode runs timer 1 in CTC mode, which clears it at the compare
+*   match, so its value on entry is the latency. While chirp mode owns timer 1 it is not free running, so
+*   timer 0 samples are not recorded.
+*
+* Sending 'H' on the USART dumps the histograms as a binary frame, decoded by host/instr_dump.py. Sending
+* 'C' clears them. The frame is:
+*
+*   0xA5 'H' INSTR_NUM_ISRS INSTR_NUM_BUCKETS F_CPU (uint32_t, little endian)
+*   per ISR: latency buckets, run time buckets (uint8_t each), max latency, max run time (uint16_t, little endian)
+*   8-bit sum of all preceding bytes
+*
+* The histograms are kept small to fit the 256 bytes of RAM. Bucket counts are 8 bits; when one would
+* overflow, all the counts of that histogram are halved, so it keeps its shape and the counts are relative.
+* The frame is streamed straight from the histograms, so it is not a snapshot: samples recorded while it is
+* being sent may show up in some buckets and not others.
+*/
+
+#include <avr/io.h>
+#include "common.h"
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include "instr.h"
+
+#ifdef DEBUG
+
+//////////////////////////////////////////////////////////////////////////
+// Private variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+// USART baud rate divisor in double speed mode, rounded, and the baud rate it gives
+#define INSTR_UBRR ((F_CPU + 4UL * INSTR_BAUD) / (8UL * INSTR_BAUD) - 1)
+#define INSTR_BAUD_ACTUAL (F_CPU / (8UL * (INSTR_UBRR + 1)))
+
+#if INSTR_BAUD_ACTUAL * 100 > INSTR_BAUD * 102UL || INSTR_BAUD_ACTUAL * 100 < INSTR_BAUD * 98UL
+#error "USART baud rate is more than 2% off at this F_CPU"
+#endif
+
+instr_histograms_t instr_histograms[INSTR_NUM_ISRS];
+volatile bool instr_timer1_free_running = false;
+uint16_t instr_pin_next_match;					// Timer 1 value at the next timer 0 compare match
+
+// Start timer 1 free running, in step with timer 0. Timer 1 is stopped and preset to 1, then started on the
+// cycle after the prescaler reset, so it reads as the number of cycles since the reset. Timer 0 is zeroed on
+// the cycle after that, long before its next prescaled tick. The three writes are in assembly so that they
+// are back to back whatever the optimization level.
+void instr_timer1_start()
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		TCCR1B = 0;										// Stop timer 1
+		TCCR1A = 0;
+		TCNT1 = 1;
+		__asm__ __volatile__ (
+			"out %[gtccr], %[psr]" "\n\t"				// Reset the prescaler shared by timers 0 and 1
+			"out %[tccr1b], %[cs]" "\n\t"				// Start timer 1: normal mode, no prescaling
+			"out %[tcnt0], __zero_reg__" "\n\t"
+			:
+			: [gtccr] "I" (_SFR_IO_ADDR(GTCCR)), [tccr1b] "I" (_SFR_IO_ADDR(TCCR1B)), [tcnt0] "I" (_SFR_IO_ADDR(TCNT0)),
+			  [psr] "r" ((uint8_t)(1 << PSR10)), [cs] "r" ((uint8_t)(1 << CS10))
+		);
+		instr_pin_next_match = INSTR_PIN_PERIOD_CYCLES;
+		instr_timer1_free_running = true;
+	}
+}
+
+// Send one byte of a dump frame and add it to the frame's sum
+void instr_send_byte(uint8_t value, uint8_t* sum)
+{
+	while (!(UCSRA & _BV(UDRE))) {}						// Wait for the transmit buffer to be empty
+	UDR = value;
+	*sum += value;
+}
+
+// Send a 16-bit value that an ISR may be updating, low byte first
+void instr_send_word(volatile const uint16_t* value, uint8_t* sum)
+{
+	uint16_t copy;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		copy = *value;
+	}
+	instr_send_byte(copy, sum);
+	instr_send_byte(copy >> 8, sum);
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Public variables and functions
+//////////////////////////////////////////////////////////////////////////
+
+// Initialize the USART and start timer 1 as the time base. Call after pin_debounce_start().
+void instr_initialize()
+{
+	UBRRH = INSTR_UBRR >> 8;
+	UBRRL = INSTR_UBRR;
+	UCSRA = (1 << U2X);
+	UCSRB = (1 << RXEN) | (1 << TXEN);
+	UCSRC = (1 << UCSZ1) | (1 << UCSZ0);				// 8 data bits, no parity, 1 stop bit
+	instr_timer1_start();
+}
+
+// Timer 1 is about to be reprogrammed, for example by chirp mode. Stop using it as the time base.
+void instr_timer1_claim()
+{
+	instr_timer1_free_running = false;
+}
+
+// Timer 1 is no longer in use elsewhere. Start it free running again.
+void instr_timer1_release()
+{
+	instr_timer1_start();
+}
+
+// Handle commands received on the USART. Call this regularly from the main loop.
+void instr_poll()
+{
+	if (!(UCSRA & _BV(RXC))) {
+		return;
+	}
+	uint8_t command = UDR;
+	if (command == 'C') {
+		ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+			uint8_t* bytes = (uint8_t*)instr_histograms;
+			for (uint8_t i = 0; i < sizeof(instr_histograms); i++) {
+				bytes[i] = 0;
+			}
+		}
+	} else if (command == 'H') {
+		uint8_t sum = 0;
+		instr_send_byte(0xA5, &sum);
+		instr_send_byte('H', &sum);
+		instr_send_byte(INSTR_NUM_ISRS, &sum);
+		instr_send_byte(INSTR_NUM_BUCKETS, &sum);
+		for (uint8_t shift = 0; shift < 32; shift += 8) {		// So that the host can convert cycles to time
+			instr_send_byte((uint8_t)(F_CPU >> shift), &sum);
+		}
+		for (uint8_t isr = 0; isr < INSTR_NUM_ISRS; isr++) {
+			volatile const uint8_t* counts = instr_histograms[isr].latency;	// Both histograms, one byte at a time
+			for (uint8_t i = 0; i < 2 * INSTR_NUM_BUCKETS; i++) {
+				instr_send_byte(counts[i], &sum);
+			}
+			instr_send_word(&instr_histograms[isr].max_latency, &sum);
+			instr_send_word(&instr_histograms[isr].max_run_time, &sum);
+		}
+		instr_send_byte(sum, &sum);
+	}
+}
+
+#endif /* DEBUG */
@@ -0,0 +1,118 @@
+/*
+* Instrumentation of interrupt service routines: entry latency and run time histograms, dumped over the USART.
+*
+* Instrumentation is only built into the Debug configuration. In other configurations the INSTR_ macros
+* expand to nothing and the module adds no code or RAM.
+*/
+
+#ifndef INSTR_H_
+#define INSTR_H_
+
+// Instrumented interrupt service routines
+#define INSTR_ISR_PIN 0					// Timer 0 compare match, input debouncing in pin.c
+#define INSTR_ISR_CHIRP 1				// Timer 1 compare match, chirp streaming in chirp.c
+#define INSTR_NUM_ISRS 2
+
+#define INSTR_NUM_BUCKETS 8				// Bucket n counts values in [2^(n+3), 2^(n+4)) cycles; first and last are open ended
+#define INSTR_BAUD 38400				// USART baud rate for the dump
+#define INSTR_NO_LATENCY 0xFFFF			// Latency unknown; the sample is not recorded
+
+#ifdef DEBUG
+
+#include "pin.h"
+
+// Timer 0 compare match period in system clock cycles. In CTC mode the match flag is set on the timer clock
+// where the count goes from TOP back to zero, so matches fall on whole periods of timer 1, which
+// instr_timer1_start() starts in phase with the prescaler. No phase correction is needed.
+#define INSTR_PIN_PERIOD_CYCLES ((PIN_TIMER0_TOP + 1UL) * PIN_TIMER0_PRESCALE)
+
+typedef struct {
+	uint8_t latency[INSTR_NUM_BUCKETS];			// Entry latency histogram
+	uint8_t run_time[INSTR_NUM_BUCKETS];		// Run time histogram, must follow the latency histogram
+	uint16_t max_latency;
+	uint16_t max_run_time;
+} instr_histograms_t;
+
+extern instr_histograms_t instr_histograms[INSTR_NUM_ISRS];
+extern volatile bool instr_timer1_free_running;
+extern uint16_t instr_pin_next_match;
+
+// The functions below run in the ISRs being measured. They are inline so that those ISRs make no calls, and
+// avr-gcc doesn't have to save every call-clobbered register on each entry, which would add to the run time
+// being measured.
+
+// Log-scale bucket of a cycle count
+static inline uint8_t instr_bucket(uint16_t cycles)
+{
+	uint8_t bucket = 0;
+	cycles >>= 4;
+	while (cycles && bucket < INSTR_NUM_BUCKETS - 1) {
+		cycles >>= 1;
+		bucket++;
+	}
+	return bucket;
+}
+
+// Count a value in a histogram, halving all its counts first if this one is full
+static inline void instr_count(uint8_t* counts, uint16_t cycles)
+{
+	uint8_t bucket = instr_bucket(cycles);
+	if (counts[bucket] == 0xFF) {
+		for (uint8_t i = 0; i < INSTR_NUM_BUCKETS; i++) {
+			counts[i] >>= 1;
+		}
+	}
+	counts[bucket]++;
+}
+
+// Record one ISR run. Called with interrupts disabled, from the ISR being measured.
+static inline void instr_record(uint8_t isr, uint16_t latency, uint16_t run_time)
+{
+	if (latency == INSTR_NO_LATENCY) {
+		return;
+	}
+	instr_histograms_t* histograms = &instr_histograms[isr];
+	instr_count(histograms->latency, latency);
+	instr_count(histograms->run_time, run_time);
+	if (latency > histograms->max_latency) {histograms->max_latency = latency;}
+	if (run_time > histograms->max_run_time) {histograms->max_run_time = run_time;}
+}
+
+// Entry latency of the timer 0 compare match ISR, given the timer 1 value on entry. If interrupts were held
+// off for more than a period, the matches that passed meanwhile were merged into this one; they are skipped,
+// and the latency is counted from the first of them. The period is at most 2^14 cycles, so a match that has
+// passed is less than 2^15 cycles behind.
+static inline uint16_t instr_pin_latency(uint16_t entry_time)
+{
+	if (!instr_timer1_free_running) {
+		return INSTR_NO_LATENCY;
+	}
+	uint16_t latency = entry_time - instr_pin_next_match;
+	do {
+		instr_pin_next_match += INSTR_PIN_PERIOD_CYCLES;
+	} while ((uint16_t)(entry_time - instr_pin_next_match) < 0x8000);
+	return latency;
+}
+
+void instr_initialize();
+void instr_timer1_claim();
+void instr_timer1_release();
+void instr_poll();
+
+// Put INSTR_ENTER() first in an ISR and INSTR_EXIT() last. Times are system clock cycles read from timer 1.
+#define INSTR_ENTER() uint16_t instr_entry_time = TCNT1
+#define INSTR_EXIT(isr, latency) instr_record((isr), (latency), TCNT1 - instr_entry_time)
+#define INSTR_ENTRY_TIME() instr_entry_time
+
+#else
+
+#define instr_initialize()
+#define instr_timer1_claim()
+#define instr_timer1_release()
+#define instr_poll()
+#define INSTR_ENTER()
+#define INSTR_EXIT(isr, latency)
+
+#endif /* DEBUG */
+
+#endif /* INSTR_H_ */
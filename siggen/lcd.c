@@ -2,12 +2,15 @@
 * Functions for handling the LCD display.
 *
 * The timing of operations in this function must meet the minimum timing constraints of the
-* Microchip 80438 display driver. This functions assumes a system clock of 16.384 MHz and that this
+* Microchip 80438 display driver. The clock delays are derived from F_CPU in timing.h, from margins found to
+* work on the board rather than from the driver's datasheet. This assumes that this
 * function has been compiled with optimization level -O1 or -Os). If the function is not compiled
 * with optimization (-O0) the function will still work, but will send bits to the LCD more slowly.
 */
 
 #include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "timing.h"
 #include "lcd.h"
 #include "bcd.h"
 
@@ -33,15 +36,10 @@ void lcd_send_variable_bits(uint8_t value, uint8_t num_bits)
 	USIDR = value;							// Load byte to be sent. This sets the DO pin to the value of the top bit.
 	for (uint8_t i=0; i<num_bits; i++) {	// Clock num_bits out of the USI shift-register
 		USICR |= _BV(USITC);				// Toggle the clock pin, falling edge. LCD samples the DO signal.
-		asm volatile("nop\n\t"				// Delay so that the clock max frequency spec is not violated
-		"nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		"nop\n\t"
-		::);
+		TIMING_DELAY_CYCLES(LCD_CLOCK_LOW_PAD_CYCLES);	// Delay so that the clock is no faster than the proven margin
 		USICR |= _BV(USITC);				// Toggle the clock pin, rising edge
 		USICR |= _BV(USICLK);				// Strobe the USI shift-register and counter; this sets up the next data bit.
+		TIMING_DELAY_CYCLES(LCD_CLOCK_HIGH_PAD_CYCLES);
 	}
 }
 
@@ -52,12 +50,7 @@ void lcd_send_variable_bits(uint8_t value, uint8_t num_bits)
 void lcd_update_display()
 {
 	PORTB |= _BV(PORTB1);		// Port B pin 1 high; Assert LCD Load
-	asm volatile("nop\n\t"		// Delay so that the minimum load time spec is not violated
-	"nop\n\t"
-	"nop\n\t"
-	"nop\n\t"
-	"nop\n\t"
-	::);
+	TIMING_DELAY_CYCLES(LCD_LOAD_PAD_CYCLES);	// Delay so that the load pulse is no shorter than the proven margin
 	PORTB &= ~_BV(PORTB1);		// Port B pin 1 low; Deassert LCD Load
 }
 
@@ -74,11 +67,11 @@ void lcd_initialize()
 	PORTB &= ~_BV(PORTB1);								// Port B pin 1 low; LCD Load low
 }
 
-// Array of LCD segment codes for the 10 numeric digits
-const uint8_t lcd_segments_numeric[10] = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+// Array of LCD segment codes for the 10 numeric digits. Stored in program memory (flash) to preserve RAM.
+const uint8_t lcd_segments_numeric[10] PROGMEM = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
 
-// Array of LCD segment codes for the 26 alphabetic characters
-const uint8_t lcd_segments_alphabetic[26] = {
+// Array of LCD segment codes for the 26 alphabetic characters. Stored in program memory (flash) to preserve RAM.
+const uint8_t lcd_segments_alphabetic[26] PROGMEM = {
 	0x77, 0x7c, 0x39, 0x5e, 0x79, 0x71, 0x3d, 0x76,
 	0x30, 0x1E, 0x76, 0x38, 0x15, 0x37, 0x3f, 0x73,
 	0x67, 0x50, 0x6d, 0x78, 0x3e, 0x1C, 0x2A, 0x76,
@@ -87,10 +80,10 @@ const uint8_t lcd_segments_alphabetic[26] = {
 uint8_t lcd_segment_code(uint8_t ascii_code) {
 	uint8_t segment_code = 0x00;									// Default is all segments off
 	if (ascii_code >= 0x30 && ascii_code <= 0x39) {					// Numeric ascii codes: 0-9
-		segment_code = lcd_segments_numeric[ascii_code - 0x30];
+		segment_code = pgm_read_byte(&lcd_segments_numeric[ascii_code - 0x30]);
 	}
 	else if (ascii_code >= 0x41 && ascii_code <= 0x5A) {			// Uppercase alphabet: A-Z
-		segment_code = lcd_segments_alphabetic[ascii_code - 0x41];
+		segment_code = pgm_read_byte(&lcd_segments_alphabetic[ascii_code - 0x41]);
 	}
 	return segment_code;
 }
@@ -7,6 +7,9 @@
 #include "common.h"
 #include <util/delay.h>
 #include <avr/interrupt.h>
+#include "pin.h"
+#include "event.h"
+#include "instr.h"
 
 /*
 * Initialize for the inputs. 
@@ -119,122 +122,108 @@ void pin_test3()
 	}
 }
 
-volatile uint8_t pb_filtered = 0;
-volatile uint8_t pb_state = 0;
-volatile uint8_t pb_state_changed = 0;
-
-volatile uint8_t encA_filtered = 0;
-volatile uint8_t encA_state = 0;
-volatile uint8_t encA_state_changed = 0;
+//////////////////////////////////////////////////////////////////////////
+// Debouncing of the front-panel inputs
+//////////////////////////////////////////////////////////////////////////
+
+// All eight port D inputs are debounced in parallel by a vertical counter. Each input has its own 2-bit
+// counter, with bit n of pin_vc0 and pin_vc1 holding the low and high counter bits for port D pin n.
+// A counter is held at its reset value while the raw input agrees with the debounced state, and counts
+// down on each tick that it disagrees. After four consecutive disagreeing samples the counter rolls over
+// and the debounced state of that input flips. The work per tick is the same no matter how many inputs
+// are in use.
+//
+// The debounced state is active high: a bit is 1 while the input pin is pulled low (switch closed).
+volatile uint8_t pin_debounced = 0;		// Debounced, active-high state of the port D inputs
+uint8_t pin_vc0 = 0xFF;					// Vertical counter, low bits
+uint8_t pin_vc1 = 0xFF;					// Vertical counter, high bits
+
+// Sample port D and advance the vertical counter of every input by one tick. Each input whose debounced
+// state changes is reported to the main loop through the event queue.
+static inline void pin_debounce_tick()
+{
+	uint8_t state = pin_debounced;
+	uint8_t delta = state ^ (uint8_t)~PIND;		// Inputs whose raw value differs from the debounced state
+	
+	pin_vc0 = ~(pin_vc0 & delta);				// Count down the inputs that differ, reset the others
+	pin_vc1 = pin_vc0 ^ (pin_vc1 & delta);
+	delta &= pin_vc0 & pin_vc1;					// Inputs whose counter rolled over; their state changes now
+	
+	state ^= delta;
+	pin_debounced = state;
+	
+	delta &= PIN_INPUT_MASK;					// Only front-panel inputs generate events
+	if (delta) {								// Rare; most ticks have no state change
+		uint8_t mask = 0x01;
+		do {
+			if (delta & mask) {
+				event_put((state & mask) ? EVENT_PIN_PRESSED : EVENT_PIN_RELEASED, mask);
+			}
+			mask <<= 1;
+		} while (mask);
+	}
+}
 
 // Interrupt service routine for timer 0 output compare match interrupt
-//ISR(TIMER0_COMPA_vect)
-//{
-	//uint8_t pb_raw;
-	//
-	//// Read raw input and convert to low=0x00 and high=0xFF
-	//pb_raw = (PIND & _BV(PIND6)) > 0 ? 0x00 : 0xFF;
-	//
-	//// Filtered value is 7/8 of previous filtered value plus 1/8 of current raw value
-	//pb_filtered = (pb_filtered - (pb_filtered >> 3)) + (pb_raw >> 3);
-	//
-	//// Compare filtered value to threshold values to see if a state change has occurred.
-	//if (pb_state == 1 && pb_filtered < 0x20) {
-		//pb_state = 0;
-	//} else if (pb_state == 0 && pb_filtered > 0xE0) {
-		//pb_state = 1;
-	//}
-//}
+ISR(TIMER0_COMPA_vect)
+{
+	INSTR_ENTER();
+	pin_debounce_tick();
+	INSTR_EXIT(INSTR_ISR_PIN, instr_pin_latency(INSTR_ENTRY_TIME()));
+}
 
-void pin_test4() {
-	pin_test_initialize();
+// Start debouncing the inputs. Timer 0 generates a compare match interrupt every PIN_TICK_CYCLES (about 250us,
+// exactly at 16.384 MHz), so an input change is accepted after it has been stable for four ticks (about 1ms).
+void pin_debounce_start()
+{
+	pin_debounced = ~PIND;				// Start from the current input levels so no edges are reported at startup
+	pin_vc0 = 0xFF;
+	pin_vc1 = 0xFF;
 	
-	// Set timer/counter 0 to generate a 2kHz square wave on the OC0A pin
-	// This corresponds to a timer compare match every 1 ms
-	// This assumes a system clock freq of 16.384 MHz
 	TCCR0A = (1 << WGM01) | (0 << WGM00); // Timer in CTC mode (Table 11-8)
 	TCCR0B = (0 << WGM02);
+	OCR0A = PIN_TIMER0_TOP; // Set the timer compare value
+	TCCR0B |= PIN_TIMER0_CS_BITS; // Set clock prescale of PIN_TIMER0_PRESCALE. Counter starts counting.
+	TIMSK |= (1 << OCIE0A); // Enable output compare match interrupt on timer 0
+}
+
+//////////////////////////////////////////////////////////////////////////
+// Test functions
+//////////////////////////////////////////////////////////////////////////
+
+void pin_test4() {
+	pin_test_initialize();
+	pin_debounce_start();
+	
+	// Also toggle the OC0A pin on each compare match to show the debounce tick rate on a scope
 	TCCR0A |= (0 << COM0A1) | (1 << COM0A0); // Toggle OC0A on compare match (Table 11-2)
 	DDRB |= (1 << OC0A_BIT); // Port B OC0A pin is an output
-	OCR0A = 63; // Set the timer compare value
-	TCCR0B |= (1 << CS02) | (0 << CS01) | (0 << CS00); // Set clock prescale (Table 11-9). Counter starts counting.
-	TIMSK = (1 << OCIE0A); // Enable output compare match interrupt on timer 0
 	
 	sei();									// Enable interrupts
 	while (1) {
-		// Set pin to indicate pb_state
-		if (pb_state == 1) {
+		// Set pin to indicate the debounced pushbutton state
+		if (pin_debounced & PIN_PB_MASK) {
 			PORTD |= _BV(PORTD5);			// Port D pin 5 high to indicate state is now 1
-		} else if (pb_state == 0) {
+		} else {
 			PORTD &= ~_BV(PORTD5);			// Port D pin 5 low to indicate state is now 0
 		}
 	}
 }
 
-void filter_pb()
-{
-	uint8_t pb_raw;
-
-	// Read raw input and convert to low=0x00 and high=0xFF
-	pb_raw = (PIND & _BV(PIND6)) > 0 ? 0x00 : 0xFF;
-
-	// Filtered value is 15/16 of previous filtered value plus 1/16 of current raw value
-	pb_filtered = (pb_filtered - (pb_filtered >> 4)) + (pb_raw >> 4);
-
-	// Compare filtered value to threshold values to see if a state change has occurred.
-	if (pb_state == 1 && pb_filtered < 0x20) {
-		pb_state = 0;
-	} else if (pb_state == 0 && pb_filtered > 0xE0) {
-		pb_state = 1;
-	}	
-}
-
-void filter_encA()
-{
-	uint8_t encA_raw;
-
-	// Read raw input and convert to low=0x00 and high=0xFF
-	encA_raw = (PIND & _BV(PIND6)) > 0 ? 0x00 : 0xFF;
-
-	// Filtered value is 1/4 of previous filtered value plus 3/4 of current raw value
-	encA_filtered = (encA_filtered >> 2) + (encA_raw - (encA_raw >> 2));
-
-	// Compare filtered value to threshold values to see if a state change has occurred.
-	if (encA_state == 1 && encA_filtered < 0x20) {
-		encA_state = 0;
-	} else if (encA_state == 0 && encA_filtered > 0xE0) {
-		encA_state = 1;
-	}
-}
-
-// Interrupt service routine for timer 0 output compare match interrupt
-ISR(TIMER0_COMPA_vect)
-{
-	filter_pb();
-//s	filter_encA();
-}
-
 void pin_test5() {
 	pin_test_initialize();
-	
-	// Set timer/counter 0 to generate a 8kHz square wave on the OC0A pin
-	// This corresponds to a timer compare match every 250us
-	// This assumes a system clock freq of 16.384 MHz
-	TCCR0A = (1 << WGM01) | (0 << WGM00); // Timer in CTC mode (Table 11-8)
-	TCCR0B = (0 << WGM02);
-	TCCR0A |= (0 << COM0A1) | (1 << COM0A0); // Toggle OC0A on compare match (Table 11-2)
-	DDRB |= (1 << OC0A_BIT); // Port B OC0A pin is an output
-	OCR0A = 63; // Set the timer compare value
-	TCCR0B |= (0 << CS02) | (1 << CS01) | (1 << CS00); // Set clock prescale (Table 11-9). Counter starts counting.
-	TIMSK = (1 << OCIE0A); // Enable output compare match interrupt on timer 0
+	pin_debounce_start();
 	
 	sei();									// Enable interrupts
+	event_t event;
 	while (1) {
-		// Set pin to indicate pb_state
-		if (pb_state == 1) {
-			PORTD |= _BV(PORTD5);			// Port D pin 5 high to indicate state is now 1
-			} else if (pb_state == 0) {
-			PORTD &= ~_BV(PORTD5);			// Port D pin 5 low to indicate state is now 0
+		// Toggle pin 5 on each press and pin 4 on each release of the pushbutton
+		if (event_get(&event) && event.data == PIN_PB_MASK) {
+			if (event.type == EVENT_PIN_PRESSED) {
+				PORTD ^= _BV(PORTD5);
+			} else if (event.type == EVENT_PIN_RELEASED) {
+				PORTD ^= _BV(PORTD4);
+			}
 		}
 	}
-}
\ No newline at end of file
+}
@@ -6,7 +6,45 @@
 #ifndef PIN_H_
 #define PIN_H_
 
+#include "common.h"
+
+// Port D input masks, as used in the debounced state and edge masks
+#define PIN_PB_MASK _BV(PIND6)			// Pushbutton
+#define PIN_INPUT_MASK (PIN_PB_MASK)	// All front-panel inputs. Other port D pins are outputs or the USART.
+
+// Timer 0 debounce tick. Timer 0 counts the system clock divided by 64 and the period is the nearest whole
+// number of timer 0 counts to 250us, so four ticks of debouncing take about 1ms at any F_CPU.
+#define PIN_TICK_US 250UL
+#define PIN_TIMER0_PRESCALE 64
+#define PIN_TIMER0_TOP ((F_CPU / (1000000UL / PIN_TICK_US) + PIN_TIMER0_PRESCALE / 2) / PIN_TIMER0_PRESCALE - 1)
+#define PIN_TICK_CYCLES ((PIN_TIMER0_TOP + 1UL) * PIN_TIMER0_PRESCALE)
+#if PIN_TIMER0_TOP > 255
+#error "PIN_TIMER0_PRESCALE is too small for the timer 0 debounce tick"
+#endif
+#if PIN_TIMER0_TOP < 1
+#error "F_CPU is too low for the timer 0 debounce tick"
+#endif
+
+// Timer 0 clock select bits for PIN_TIMER0_PRESCALE (Table 11-9)
+#if PIN_TIMER0_PRESCALE == 1
+#define PIN_TIMER0_CS_BITS (1 << CS00)
+#elif PIN_TIMER0_PRESCALE == 8
+#define PIN_TIMER0_CS_BITS (1 << CS01)
+#elif PIN_TIMER0_PRESCALE == 64
+#define PIN_TIMER0_CS_BITS ((1 << CS01) | (1 << CS00))
+#elif PIN_TIMER0_PRESCALE == 256
+#define PIN_TIMER0_CS_BITS (1 << CS02)
+#elif PIN_TIMER0_PRESCALE == 1024
+#define PIN_TIMER0_CS_BITS ((1 << CS02) | (1 << CS00))
+#else
+#error "PIN_TIMER0_PRESCALE must be 1, 8, 64, 256 or 1024"
+#endif
+
+// Debounced, active-high state of the port D inputs. Updated on every tick of the timer 0 interrupt.
+extern volatile uint8_t pin_debounced;
+
 void pin_initialize();
+void pin_debounce_start();
 void pin_test1();
 void pin_test2();
 void pin_test3();
@@ -2,10 +2,15 @@
 #include "common.h"
 #include <util/delay.h>
 #include <stdlib.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "pin.h"
 #include "lcd.h"
 #include "dds.h"
 #include "bcd.h"
+#include "chirp.h"
+#include "event.h"
+#include "instr.h"
 
 /*
 * Initialization of the USI peripheral. USI is used to communicate with the DDS chip and the LCD.
@@ -16,14 +21,80 @@ void usi_initialize()
 	USICR = _BV(USIWM0);									// USI in 3-wire mode, software clock strobe
 }
 
+/*
+* Reference clock calibration mode, entered by holding the pushbutton at power-up. The DDS puts out the
+* calibration tuning word and the LCD shows the measured frequency to be entered, starting from nominal, with
+* the digit being edited blinking. A short press steps that digit; holding the button for a second moves on
+* to the next digit, and after the last one passes the value to dds_calibrate(). The LCD shows CAL GOOD or
+* CAL FAIL; after a failure, for example a value more than 1% away from nominal, entry starts again.
+*/
+#define CALIBRATION_DIGITS 7					// Digits entered, 1 MHz to 1 Hz
+#define CALIBRATION_POLL_MS 10					// Main loop period in calibration mode
+#define CALIBRATION_HOLD_POLLS 100				// Polls the button is held to move on to the next digit
+#define CALIBRATION_BLINK_POLLS 25				// Polls between blinks of the digit being edited
+#define CALIBRATION_RESULT_MS 2000				// Time the result is shown
+
+// Result messages, in flash since string literals take RAM. One LCD's worth of characters, without a terminator.
+const char calibration_good[8] PROGMEM = "CAL GOOD";
+const char calibration_fail[8] PROGMEM = "CAL FAIL";
+
+void calibration_mode()
+{
+	uint8_t bcd_buf[10];
+	bin_to_ten_dec_digits(DDS_CALIBRATION_FREQ, bcd_buf);
+	uint8_t* digits = &bcd_buf[10 - CALIBRATION_DIGITS];	// Most significant digit first
+	char ascii_buf[8];
+	event_t event;
+	uint8_t digit = 0;
+	uint8_t held = 0;									// Polls the button has been held, 0 when released
+	uint8_t blink = 0;
+
+	dds_calibration_start();
+	while (pin_debounced & PIN_PB_MASK) {}			// Wait for the power-up press to be released
+	while (event_get(&event)) {}
+	while (1) {
+		_delay_ms(CALIBRATION_POLL_MS);
+		if (event_get(&event) && event.data == PIN_PB_MASK) {
+			if (event.type == EVENT_PIN_PRESSED) {
+				held = 1;
+			} else if (held > 0) {						// Short press: step the digit
+				digits[digit] = digits[digit] == 9 ? 0 : digits[digit] + 1;
+				held = 0;
+			}
+		} else if (held > 0 && ++held == CALIBRATION_HOLD_POLLS) {
+			held = 0;									// Long press: move on; ignore the release
+			if (++digit == CALIBRATION_DIGITS) {
+				uint32_t measured = 0;
+				for (digit = 0; digit < CALIBRATION_DIGITS; digit++) {
+					measured = measured * 10 + digits[digit];
+				}
+				bool good = dds_calibrate(measured);
+				memcpy_P(ascii_buf, good ? calibration_good : calibration_fail, sizeof(ascii_buf));
+				lcd_show_ascii(ascii_buf);
+				_delay_ms(CALIBRATION_RESULT_MS);
+				if (good) {
+					return;
+				}
+				digit = 0;									// Start entry again from the value entered
+			}
+		}
+		if (++blink == 2 * CALIBRATION_BLINK_POLLS) {blink = 0;}
+		for (uint8_t j = 0; j < 8; j++) {
+			uint8_t k = j - (8 - CALIBRATION_DIGITS);
+			ascii_buf[j] = j < 8 - CALIBRATION_DIGITS || (k == digit && blink < CALIBRATION_BLINK_POLLS) ? ' ' : digits[k] + 0x30;
+		}
+		lcd_show_ascii(ascii_buf);
+	}
+}
+
 int main(void)
 {
 	//_delay_ms(1000);
 	
-	pin_initialize();
 	usi_initialize();
+	dds_initialize();			// First, so that a restored output comes up as soon as possible
+	pin_initialize();
 	lcd_initialize();
-	dds_initialize();
 	
 	// Input tests
 //	pin_test1();
@@ -36,6 +107,11 @@ int main(void)
 //	dds_test3();
 //	dds_test4();
 //	dds_test5();
+//	dds_test6();
+//	dds_test7();			// Needs DDS_NUM_DEVICES 2
+
+	// Chirp tests
+//	chirp_test1();			// Needs CHIRP_ENABLE 1
 
 //while (1) {
 	//lcd_show_integer(12345678);
@@ -83,11 +159,30 @@ int main(void)
 		//_delay_ms(5000);
 	//}
 
-	uint32_t i = 100000;
+	// Resume from the frequency saved in EEPROM. Pressing the pushbutton saves the current frequency. If the
+	// EEPROM write queue is too full to take the save, for example while a calibration is still being written,
+	// the save stays pending and is retried on the following passes with the frequency current at that time.
+	uint32_t i = dds_restored_display_value();
+	if (i < 100000 || i > 2000000) {i = 100000;}
+	event_t event;
+	bool save_pending = false;
+	pin_debounce_start();
+	instr_initialize();
+	sei();
+	if (pin_debounced & PIN_PB_MASK) {
+		calibration_mode();
+	}
 	while (1) {
 //		_delay_ms(1);
 		lcd_show_integer(i);
 		dds_set_frequency_integral(i);
+		instr_poll();
+		if (event_get(&event) && event.type == EVENT_PIN_PRESSED && event.data == PIN_PB_MASK) {
+			save_pending = true;
+		}
+		if (save_pending && dds_save_state(i)) {
+			save_pending = false;
+		}
 		i += 100;
 		if (i > 2000000) {i = 100000;}
 	}
@@ -0,0 +1,76 @@
+/*
+* Signal timing derived from the system clock.
+*
+* The delays in the bit-banged DDS and LCD transfers are worked out here at compile time from F_CPU and a
+* minimum time for each phase, so that F_CPU can be changed in common.h without re-tuning them. The DDS clock
+* high time is the AD9834 datasheet limit; the DDS clock low time and the LCD times are empirical margins, not
+* datasheet limits; see below. The build fails if F_CPU is outside what the ATtiny4313 supports, or if the DDS
+* serial clock would run faster than the AD9834 allows.
+*/
+
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include "common.h"
+
+#if F_CPU > 20000000UL
+#error "F_CPU is above the 20 MHz maximum of the ATtiny4313"
+#endif
+#if F_CPU < 1000000UL
+#error "F_CPU is too low for the debounce tick and the USART"
+#endif
+
+// Number of whole system clock cycles that last at least ns nanoseconds
+#define TIMING_CYCLES_NS(ns) (((ns) * (F_CPU / 1000UL) + 999999UL) / 1000000UL)
+
+// Cycles to pad with so that a phase whose instructions already take fixed_cycles lasts at least ns
+#define TIMING_PAD_CYCLES(ns, fixed_cycles) \
+	(TIMING_CYCLES_NS(ns) > (fixed_cycles) ? TIMING_CYCLES_NS(ns) - (fixed_cycles) : 0)
+
+// Busy-wait for a compile-time number of cycles. Expands to nothing for 0.
+#define TIMING_DELAY_CYCLES(cycles) do { if (cycles) {__builtin_avr_delay_cycles(cycles);} } while (0)
+
+// Cycles taken by the transfer loops in dds.c and lcd.c when compiled with -O1 or -Os. The low phase of the
+// serial clock is the toggle that ends it; the high phase is the shift register strobe, the loop counter
+// and branch, and the toggle that ends it.
+#define TIMING_SCLK_LOW_FIXED_CYCLES 2
+#define TIMING_SCLK_HIGH_FIXED_CYCLES 6
+#define TIMING_PULSE_FIXED_CYCLES 2
+
+// AD9834 serial interface minimums (datasheet t4: SCLK period; t5, t6: SCLK high and low time)
+#define TIMING_AD9834_SCLK_PERIOD_MIN_NS 25UL
+#define TIMING_AD9834_SCLK_HIGH_MIN_NS 10UL
+#define TIMING_AD9834_SCLK_LOW_MIN_NS 10UL
+
+// AD9834 clock low time. An empirical margin, not a datasheet limit: the board ran with four NOPs in the low
+// phase at 16.384 MHz, 6 cycles or 366 ns, and this keeps those NOPs at that clock. The high phase had no NOPs
+// and is padded only to the datasheet minimum.
+#define TIMING_AD9834_SCLK_LOW_MARGIN_NS 360UL
+#if TIMING_AD9834_SCLK_LOW_MARGIN_NS < TIMING_AD9834_SCLK_LOW_MIN_NS
+#error "TIMING_AD9834_SCLK_LOW_MARGIN_NS is below the AD9834 SCLK low time"
+#endif
+
+// 80438 clock high and low time and load pulse width. These are empirical margins, not datasheet limits: they
+// are the times given by the NOP delays that were tuned by hand and run on the board at 16.384 MHz, rounded
+// so that the high phase needs no padding at that clock. Keeping them at other F_CPU values keeps the LCD
+// transfer no faster than what is known to work, but is not a guarantee against the driver's own timing.
+#define TIMING_80438_CLOCK_HIGH_MARGIN_NS 360UL
+#define TIMING_80438_CLOCK_LOW_MARGIN_NS 480UL
+#define TIMING_80438_LOAD_MARGIN_NS 420UL
+
+// Padding for each phase
+#define DDS_SCLK_HIGH_PAD_CYCLES TIMING_PAD_CYCLES(TIMING_AD9834_SCLK_HIGH_MIN_NS, TIMING_SCLK_HIGH_FIXED_CYCLES)
+#define DDS_SCLK_LOW_PAD_CYCLES TIMING_PAD_CYCLES(TIMING_AD9834_SCLK_LOW_MARGIN_NS, TIMING_SCLK_LOW_FIXED_CYCLES)
+#define LCD_CLOCK_HIGH_PAD_CYCLES TIMING_PAD_CYCLES(TIMING_80438_CLOCK_HIGH_MARGIN_NS, TIMING_SCLK_HIGH_FIXED_CYCLES)
+#define LCD_CLOCK_LOW_PAD_CYCLES TIMING_PAD_CYCLES(TIMING_80438_CLOCK_LOW_MARGIN_NS, TIMING_SCLK_LOW_FIXED_CYCLES)
+#define LCD_LOAD_PAD_CYCLES TIMING_PAD_CYCLES(TIMING_80438_LOAD_MARGIN_NS, TIMING_PULSE_FIXED_CYCLES)
+
+// The padding meets the DDS high and low times by construction, so only the SCLK period is checked. With the
+// fixed loop cycles above, the period is at least 8 cycles, which is under 25 ns only above 320 MHz: this
+// check cannot fail at any F_CPU the ATtiny4313 supports, and only guards edits to the fixed cycle counts.
+#if (TIMING_SCLK_HIGH_FIXED_CYCLES + DDS_SCLK_HIGH_PAD_CYCLES + TIMING_SCLK_LOW_FIXED_CYCLES + DDS_SCLK_LOW_PAD_CYCLES) \
+	* 1000000000UL < TIMING_AD9834_SCLK_PERIOD_MIN_NS * F_CPU
+#error "DDS serial clock is faster than the AD9834 SCLK period allows"
+#endif
+
+#endif /* TIMING_H_ */